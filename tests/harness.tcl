@@ -5,6 +5,7 @@ namespace eval ::syslogtest::harness {
     variable log_file      ""
     variable server_script [file join [file dirname [info script]] server.tcl]
     variable server_port   8888
+    variable socket_path   ""
 }
 
 proc ::syslogtest::harness::request {args} {
@@ -38,6 +39,7 @@ proc ::syslogtest::harness::start {{timeoutMs 5000} {datasource syslog}} {
     variable log_file
     variable server_script
     variable server_port
+    variable socket_path
 
     if {$channel ne ""} {
         return
@@ -49,6 +51,14 @@ proc ::syslogtest::harness::start {{timeoutMs 5000} {datasource syslog}} {
     set log_file [file join /tmp "tcl-syslog-test-server-${token}.log"]
 
     set cmd         [list [info nameofexecutable] $server_script -port $port -source $datasource]
+
+    # the sink datasource is a private syslog daemon the extension is pointed
+    # at with '::syslog::open -socket [::syslogtest::harness::socket_path]'
+
+    if {$datasource eq "sink"} {
+        set socket_path [file join /tmp "tcl-syslog-test-${token}.sock"]
+        lappend cmd -socket $socket_path
+    }
     set pids        [exec {*}$cmd >$log_file 2>@1 &]
     set server_pid  [lindex $pids 0]
 
@@ -114,6 +124,12 @@ proc ::syslogtest::harness::stop {} {
         catch {file delete -force -- $log_file}
     }
     set log_file ""
+    set socket_path ""
+}
+
+proc ::syslogtest::harness::socket_path {} {
+    variable socket_path
+    return $socket_path
 }
 
 proc ::syslogtest::harness::wait_for_response {text {timeoutMs 5000} {pattern_type literal}} {
@@ -121,7 +137,33 @@ proc ::syslogtest::harness::wait_for_response {text {timeoutMs 5000} {pattern_ty
     return [dict create \
         raw [lindex $response 0] \
         payload [lindex $response 1] \
-        timestamp_kind [lindex $response 2]]
+        timestamp_kind [lindex $response 2] \
+        received_us [lindex $response 3]]
+}
+
+# delivered --
+#
+# waits until the server has received at least 'expected' records since
+# the last reset (or timeoutMs elapsed) and returns the number received
+#
+
+proc ::syslogtest::harness::delivered {expected {timeoutMs 5000}} {
+    return [lindex [request count $expected $timeoutMs] 0]
+}
+
+# stats --
+#
+# dictionary of delivery statistics: 'received' and, for messages
+# carrying a 't_us=[clock microseconds]' token, the end-to-end latency
+# figures min_us avg_us p50_us p99_us max_us
+#
+
+proc ::syslogtest::harness::stats {} {
+    return [lindex [request stats] 0]
+}
+
+proc ::syslogtest::harness::reset {} {
+    request reset
 }
 
 package provide harness 1.0
@@ -31,11 +31,24 @@ load [file join $current_script_path .. libtcl9syslog${version}.so]
 
 source [file join [file dirname [info script]] harness.tcl]
 
+# the in-tree sink (make syslogsink) is preferred to the system log as it
+# doesn't depend on a running syslogd and it lets tests count delivered records
+
+set datasource syslog
+if {[file executable [file join $current_script_path .. syslogsink]]} {
+    set datasource sink
+}
+
 set hasSyslogWatcher 0
-if {![catch {::syslogtest::harness::start 7000} startErr]} {
+if {![catch {::syslogtest::harness::start 7000 $datasource} startErr]} {
     set hasSyslogWatcher 1
+    if {$datasource eq "sink"} {
+        ::syslog::open -socket [::syslogtest::harness::socket_path]
+    }
 }
 ::tcltest::testConstraint hasSyslogWatcher $hasSyslogWatcher
+::tcltest::testConstraint hasSyslogSink [expr {$hasSyslogWatcher && ($datasource eq "sink")}]
+::tcltest::testConstraint threaded [info exists ::tcl_platform(threaded)]
 
 set base "TCLTEST-SYSLOG-[pid]-[clock milliseconds]"
 
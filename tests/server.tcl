@@ -8,10 +8,22 @@ namespace eval ::syslogtest::server {
     variable sourceCmd      {}
     variable listener       ""
     variable running        1
+    variable sinkProgram    [file join [file dirname [file normalize [info script]]] .. syslogsink]
+
+    # delivery statistics collected on every line read from the source
+
+    variable received       0
+    variable latencies      {}
+
+    # parsed lines not yet examined by a 'wait' request
+
+    variable pending        {}
+    variable maxPending     10000
+    variable tick           0
 }
 
 proc ::syslogtest::server::usage {} {
-    puts stderr "usage: server.tcl ?-source syslog|journalctl?"
+    puts stderr "usage: server.tcl -port port ?-source syslog|journalctl|sink? ?-socket path? ?-sink program?"
     exit 2
 }
 
@@ -22,6 +34,8 @@ proc ::syslogtest::server::parseArgs {argv} {
         set arg [lindex $argv $i]
         switch -- $arg {
             -port -
+            -socket -
+            -sink -
             -source {
                 incr i
                 if {$i >= $n} {
@@ -38,10 +52,23 @@ proc ::syslogtest::server::parseArgs {argv} {
     return $opts
 }
 
-proc ::syslogtest::server::buildSourceCommand {preferred} {
+proc ::syslogtest::server::buildSourceCommand {preferred opts} {
+    variable sinkProgram
+
     set tail        [auto_execok tail]
     set journalctl  [auto_execok journalctl]
 
+    if {$preferred eq "sink"} {
+        if {[dict exists $opts -sink]} { set sinkProgram [dict get $opts -sink] }
+        if {![dict exists $opts -socket]} {
+            error "sink source requires -socket"
+        }
+        if {![file executable $sinkProgram]} {
+            error "sink program '$sinkProgram' is not available (run 'make syslogsink')"
+        }
+        return [dict create kind sink cmd [list $sinkProgram -socket [dict get $opts -socket]]]
+    }
+
     if {$preferred eq "syslog"} {
         if {[file readable /var/log/syslog] && $tail ne ""} {
             return [dict create kind syslog cmd [list $tail -n 10 -f /var/log/syslog]]
@@ -80,8 +107,155 @@ proc ::syslogtest::server::openSource {} {
 
     puts "opening source with command --> $sourceCmd"
 
-    set sourceChannel [open |$sourceCmd r]
+    # the sink watches its stdin and exits when we close the pipe
+
+    if {$sourceKind eq "sink"} {
+        set sourceChannel [open |[concat $sourceCmd [list 2>@ stderr]] r+]
+    } else {
+        set sourceChannel [open |$sourceCmd r]
+    }
     fconfigure $sourceChannel -blocking 0 -buffering line -encoding utf-8 -translation auto
+
+    # the source is read as soon as lines are available: a sink whose output
+    # isn't consumed would block and stall the senders
+
+    chan event $sourceChannel readable [list [namespace current]::onSourceReadable]
+}
+
+proc ::syslogtest::server::onSourceReadable {} {
+    variable sourceChannel
+    variable sourceKind
+    variable pending
+    variable maxPending
+
+    while {[gets $sourceChannel line] >= 0} {
+        if {$sourceKind eq "sink"} {
+            set parsed [parseSinkLine $line]
+        } else {
+            set parsed [parseLine $line]
+        }
+        record $parsed
+        lappend pending $parsed
+    }
+    if {[llength $pending] > $maxPending} {
+        set pending [lrange $pending end-[expr {$maxPending - 1}] end]
+    }
+
+    if {[eof $sourceChannel]} {
+        chan event $sourceChannel readable ""
+        if {$sourceKind ne "sink"} {
+            [namespace current]::openSource
+        }
+    }
+}
+
+# pause --
+#
+# waits ms milliseconds while serving events, the source in particular
+#
+
+proc ::syslogtest::server::pause {ms} {
+    after $ms [list set [namespace current]::tick 1]
+    vwait [namespace current]::tick
+}
+
+# parseSinkLine --
+#
+# syslogsink lines are '<sequence> <receive time us> <record>' where
+# record is the datagram as it was sent: '<pri>Mmm dd hh:mm:ss tag: message'
+#
+
+proc ::syslogtest::server::parseSinkLine {line} {
+    set parsed [dict create raw $line payload $line timestamp_kind none \
+                            sequence "" received_us "" priority "" tag ""]
+    if {![regexp {^([0-9]+) ([0-9]+) (.*)$} $line -> sequence received record]} {
+        return $parsed
+    }
+    dict set parsed raw         $record
+    dict set parsed payload     $record
+    dict set parsed sequence    $sequence
+    dict set parsed received_us $received
+
+    if {[regexp {^<([0-9]+)>(.*)$} $record -> priority record]} {
+        dict set parsed priority $priority
+    }
+    if {[regexp {^[A-Z][a-z]{2}\s+[ 0-9]?[0-9]\s[0-9]{2}:[0-9]{2}:[0-9]{2}\s(.*)$} $record -> record]} {
+        dict set parsed timestamp_kind rfc3164
+    }
+    if {[regexp {^([^: ]+): (.*)$} $record -> tag message]} {
+        dict set parsed tag $tag
+        set record $message
+    }
+    dict set parsed payload $record
+    return $parsed
+}
+
+# record --
+#
+# accounts a line read from the source. Messages carrying a 't_us=<microseconds>'
+# token (the sender's [clock microseconds]) contribute to the latency statistics
+#
+
+proc ::syslogtest::server::record {parsed} {
+    variable received
+    variable latencies
+
+    incr received
+    if {[dict exists $parsed received_us] && [dict get $parsed received_us] ne "" && \
+        [regexp {t_us=([0-9]+)} [dict get $parsed payload] -> sent_us]} {
+        lappend latencies [expr {[dict get $parsed received_us] - $sent_us}]
+    }
+}
+
+# readLine --
+#
+# returns the oldest line not yet examined or an empty string
+#
+
+proc ::syslogtest::server::readLine {} {
+    variable pending
+
+    if {[llength $pending] == 0} { return "" }
+    set pending [lassign $pending parsed]
+    return $parsed
+}
+
+# drain --
+#
+# processes whatever the source has made available so far
+#
+
+proc ::syslogtest::server::drain {} {
+    update
+}
+
+proc ::syslogtest::server::waitCount {count timeoutMs} {
+    variable received
+
+    set deadline [expr {[clock milliseconds] + $timeoutMs}]
+    while {1} {
+        drain
+        if {$received >= $count} { return $received }
+        if {[clock milliseconds] > $deadline} { return $received }
+        [namespace current]::pause 20
+    }
+}
+
+proc ::syslogtest::server::latencyStats {} {
+    variable received
+    variable latencies
+
+    set stats [dict create received $received samples [llength $latencies]]
+    if {[llength $latencies] == 0} { return $stats }
+
+    set sorted [lsort -integer $latencies]
+    set n      [llength $sorted]
+    dict set stats min_us [lindex $sorted 0]
+    dict set stats max_us [lindex $sorted end]
+    dict set stats avg_us [expr {[tcl::mathop::+ {*}$sorted] / $n}]
+    dict set stats p50_us [lindex $sorted [expr {$n / 2}]]
+    dict set stats p99_us [lindex $sorted [expr {min($n - 1,($n * 99) / 100)}]]
+    return $stats
 }
 
 proc ::syslogtest::server::parseLine {line} {
@@ -134,23 +308,15 @@ proc ::syslogtest::server::waitFor {mode pattern timeoutMs} {
 
     set deadline [expr {[clock milliseconds] + $timeoutMs}]
     while {[clock milliseconds] <= $deadline} {
-        if {[eof $sourceChannel]} {
-            [namespace current]::openSource
-            after 50
-            continue
-        }
-
-        set n [gets $sourceChannel line]
-        if {$n >= 0} {
-            set parsed_d [parseLine $line]
-
+        set parsed_d [[namespace current]::readLine]
+        if {$parsed_d ne ""} {
             if {[[namespace current]::matches $mode $pattern $parsed_d]} {
                 return $parsed_d
             }
             continue
         }
 
-        after 50
+        [namespace current]::pause 50
     }
 
     error "timeout after ${timeoutMs}ms waiting for $mode match"
@@ -201,10 +367,32 @@ proc ::syslogtest::server::onClientReadable {chan} {
                 return
             }
 
+            set received_us ""
+            if {[dict exists $parsed received_us]} { set received_us [dict get $parsed received_us] }
             [namespace current]::writeResponse $chan ok                         \
                                                 [dict get $parsed raw]          \
                                                 [dict get $parsed payload]      \
-                                                [dict get $parsed timestamp_kind]
+                                                [dict get $parsed timestamp_kind] \
+                                                $received_us
+        }
+        count {
+            if {[llength $line] != 3} {
+                [namespace current]::writeResponse $chan error "usage: count expected timeoutMs"
+                return
+            }
+            [namespace current]::writeResponse $chan ok \
+                [[namespace current]::waitCount [lindex $line 1] [lindex $line 2]]
+        }
+        stats {
+            [namespace current]::drain
+            [namespace current]::writeResponse $chan ok [[namespace current]::latencyStats]
+        }
+        reset {
+            [namespace current]::drain
+            set ::syslogtest::server::received  0
+            set ::syslogtest::server::latencies {}
+            set ::syslogtest::server::pending   {}
+            [namespace current]::writeResponse $chan ok
         }
         shutdown {
             [namespace current]::writeResponse $chan ok bye
@@ -228,7 +416,7 @@ proc ::syslogtest::server::main {argv} {
     variable running
 
     set opts [parseArgs $argv]
-    set source [buildSourceCommand [dict get $opts -source]]
+    set source [buildSourceCommand [dict get $opts -source] $opts]
     set sourceCmd   [dict get $source cmd]
     set sourceKind  [dict get $source kind]
     [namespace current]::openSource
@@ -0,0 +1,319 @@
+/*
+ *    syslogsink.c - a minimal syslog daemon for the tcl-syslog test suite
+ *
+ *    Copyright (C) 2026 Massimo Manghi <mxmanghi@apache.org>
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * syslogsink binds a private AF_UNIX datagram socket (and optionally
+ * a UDP and/or a TCP socket on the loopback interface) and writes every
+ * record it receives on stdout as a line
+ *
+ *      <sequence> <receive time in microseconds> <record>
+ *
+ * On TCP connections records are framed as RFC 6587 describes: either
+ * octet counted ('<length> <record>') or terminated by '\n' or '\0'.
+ * A record split across reads is kept in the buffer of its connection
+ * until the rest of it arrives.
+ *
+ * Control characters in the record are written as '#ooo' octal escapes
+ * (the same convention rsyslog adopts) so that every record is exactly
+ * one line. The test server (tests/server.tcl) reads these lines
+ * through a pipe. The sink exits when its stdin is closed or on SIGTERM,
+ * removing the socket file.
+ *
+ *  usage: syslogsink -socket path ?-udp port? ?-tcp port? ?-rcvbuf bytes?
+ */
+
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#define SINK_BUFFER_SIZE    (256*1024)
+#define SINK_MAX_FDS        34
+
+typedef struct SinkClient {
+    char*   data;       /* bytes received not yet forming a whole record */
+    size_t  length;
+    size_t  size;
+} SinkClient;
+
+static volatile sig_atomic_t running = 1;
+static unsigned long long    sequence = 0;
+static char                  buffer[SINK_BUFFER_SIZE];
+static SinkClient            clients[SINK_MAX_FDS];     /* parallel to the poll set */
+
+static void on_signal (int sig)
+{
+    running = 0;
+}
+
+static void usage (void)
+{
+    fprintf(stderr,"usage: syslogsink -socket path ?-udp port? ?-tcp port? ?-rcvbuf bytes?\n");
+    exit(2);
+}
+
+static long long now_us (void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME,&ts);
+    return (long long) ts.tv_sec * 1000000LL + ts.tv_nsec / 1000;
+}
+
+static void emit_record (const char* record,size_t len,long long received)
+{
+    size_t i;
+
+    /* stream senders terminate records with '\0' or '\n' */
+
+    while ((len > 0) && ((record[len-1] == '\0') || (record[len-1] == '\n'))) { len--; }
+
+    printf("%llu %lld ",++sequence,received);
+    for (i = 0; i < len; i++) {
+        unsigned char c = (unsigned char) record[i];
+        if ((c < 0x20) || (c == 0x7f)) {
+            printf("#%03o",c);
+        } else {
+            putchar(c);
+        }
+    }
+    putchar('\n');
+    fflush(stdout);
+}
+
+/*
+ * emit_stream
+ *
+ * Appends the n bytes read from a TCP connection to its buffer and
+ * emits every record completed. An octet counted record is emitted
+ * once all of its bytes have arrived, a record without a count once its
+ * terminator has arrived
+ */
+
+static void emit_stream (SinkClient* client,const char* data,size_t n,long long received)
+{
+    size_t start = 0;
+
+    if (client->length + n > client->size) {
+        client->size = (client->length + n) * 2;
+        client->data = realloc(client->data,client->size);
+        if (client->data == NULL) {
+            fprintf(stderr,"syslogsink: out of memory\n");
+            exit(1);
+        }
+    }
+    memcpy(client->data + client->length,data,n);
+    client->length += n;
+
+    while (start < client->length) {
+        char*   record = client->data + start;
+        size_t  available = client->length - start;
+        size_t  i;
+
+        if ((*record >= '1') && (*record <= '9')) {
+            size_t count = 0;
+
+            for (i = 0; (i < available) && (record[i] >= '0') && (record[i] <= '9'); i++) {
+                count = count * 10 + (record[i] - '0');
+            }
+            if (i == available) { break; }
+            if (record[i] == ' ') {
+                if (available - i - 1 < count) { break; }
+                emit_record(record + i + 1,count,received);
+                start += i + 1 + count;
+                continue;
+            }
+
+            /* digits not followed by a space: a record without a count */
+        }
+
+        for (i = 0; (i < available) && (record[i] != '\n') && (record[i] != '\0'); i++) { }
+        if (i == available) { break; }
+        if (i > 0) { emit_record(record,i,received); }
+        start += i + 1;
+    }
+
+    memmove(client->data,client->data + start,client->length - start);
+    client->length -= start;
+}
+
+static int bind_inet (int type,int port)
+{
+    struct sockaddr_in  addr;
+    int                 on = 1;
+    int                 fd = socket(AF_INET,type,0);
+
+    if (fd < 0) { return -1; }
+    setsockopt(fd,SOL_SOCKET,SO_REUSEADDR,&on,sizeof(on));
+
+    memset(&addr,0,sizeof(addr));
+    addr.sin_family      = AF_INET;
+    addr.sin_port        = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (bind(fd,(struct sockaddr *) &addr,sizeof(addr)) < 0) {
+        close(fd);
+        return -1;
+    }
+    if ((type == SOCK_STREAM) && (listen(fd,16) < 0)) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+int main (int argc,char* argv[])
+{
+    struct pollfd       fds[SINK_MAX_FDS];
+    struct sockaddr_un  addr;
+    const char*         socket_path = NULL;
+    int                 udp_port = 0;
+    int                 tcp_port = 0;
+    int                 rcvbuf = 0;
+    int                 nfds = 0;
+    int                 nlisteners;
+    int                 listener = -1;
+    int                 i;
+
+    for (i = 1; i < argc; i++) {
+        if (i == argc-1) { usage(); }
+        if (strcmp(argv[i],"-socket") == 0) {
+            socket_path = argv[++i];
+        } else if (strcmp(argv[i],"-udp") == 0) {
+            udp_port = atoi(argv[++i]);
+        } else if (strcmp(argv[i],"-tcp") == 0) {
+            tcp_port = atoi(argv[++i]);
+        } else if (strcmp(argv[i],"-rcvbuf") == 0) {
+            rcvbuf = atoi(argv[++i]);
+        } else {
+            usage();
+        }
+    }
+    if ((socket_path == NULL) || (strlen(socket_path) >= sizeof(addr.sun_path))) { usage(); }
+
+    signal(SIGTERM,on_signal);
+    signal(SIGINT,on_signal);
+    signal(SIGPIPE,SIG_IGN);
+
+    /* stdin is watched so that the sink goes away with the process reading it */
+
+    fds[nfds].fd = STDIN_FILENO;
+    fds[nfds++].events = POLLIN;
+
+    memset(&addr,0,sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path,socket_path);
+    unlink(socket_path);
+
+    fds[nfds].fd = socket(AF_UNIX,SOCK_DGRAM,0);
+    if ((fds[nfds].fd < 0) || (bind(fds[nfds].fd,(struct sockaddr *) &addr,sizeof(addr)) < 0)) {
+        fprintf(stderr,"syslogsink: cannot bind %s: %s\n",socket_path,strerror(errno));
+        return 1;
+    }
+    if (rcvbuf > 0) {
+        setsockopt(fds[nfds].fd,SOL_SOCKET,SO_RCVBUF,&rcvbuf,sizeof(rcvbuf));
+    }
+    fds[nfds++].events = POLLIN;
+
+    if (udp_port > 0) {
+        if ((fds[nfds].fd = bind_inet(SOCK_DGRAM,udp_port)) < 0) {
+            fprintf(stderr,"syslogsink: cannot bind udp port %d: %s\n",udp_port,strerror(errno));
+            unlink(socket_path);
+            return 1;
+        }
+        fds[nfds++].events = POLLIN;
+    }
+
+    if (tcp_port > 0) {
+        if ((listener = bind_inet(SOCK_STREAM,tcp_port)) < 0) {
+            fprintf(stderr,"syslogsink: cannot bind tcp port %d: %s\n",tcp_port,strerror(errno));
+            unlink(socket_path);
+            return 1;
+        }
+        fds[nfds].fd = listener;
+        fds[nfds++].events = POLLIN;
+    }
+
+    nlisteners = nfds;
+    fprintf(stderr,"syslogsink: listening on %s\n",socket_path);
+
+    while (running) {
+        if (poll(fds,nfds,500) < 0) {
+            if (errno == EINTR) { continue; }
+            break;
+        }
+
+        for (i = 0; i < nfds; i++) {
+            if ((fds[i].revents & (POLLIN|POLLHUP|POLLERR)) == 0) { continue; }
+
+            if (fds[i].fd == STDIN_FILENO) {
+                if (read(STDIN_FILENO,buffer,sizeof(buffer)) <= 0) { running = 0; }
+            } else if (fds[i].fd == listener) {
+                int client = accept(listener,NULL,NULL);
+                if ((client >= 0) && (nfds < SINK_MAX_FDS)) {
+                    fds[nfds].fd = client;
+                    fds[nfds].events = POLLIN;
+                    fds[nfds].revents = 0;
+                    clients[nfds++].length = 0;
+                } else if (client >= 0) {
+                    close(client);
+                }
+            } else {
+                ssize_t n = recv(fds[i].fd,buffer,sizeof(buffer),0);
+                long long received = now_us();
+
+                if ((n < 0) && (errno == EINTR)) { continue; }
+
+                /* descriptors past the listeners are TCP connections */
+
+                if (n > 0) {
+                    if (i >= nlisteners) {
+                        emit_stream(&clients[i],buffer,n,received);
+                    } else {
+                        emit_record(buffer,n,received);
+                    }
+                } else if (i >= nlisteners) {
+
+                    /* the connection is closed (or failed): a record left
+                     * without its terminator is emitted as it is */
+
+                    if (clients[i].length > 0) {
+                        emit_record(clients[i].data,clients[i].length,received);
+                    }
+                    close(fds[i].fd);
+                    free(clients[i].data);
+                    nfds--;
+                    fds[i] = fds[nfds];
+                    clients[i] = clients[nfds];
+                    memset(&clients[nfds],0,sizeof(SinkClient));
+                    i--;
+                }
+            }
+        }
+    }
+
+    unlink(socket_path);
+    return 0;
+}
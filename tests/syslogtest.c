@@ -0,0 +1,155 @@
+/*
+ *    syslogtest.c - extension exercising the C interface in the test suite
+ *
+ *    Copyright (C) 2026 Massimo Manghi <mxmanghi@apache.org>
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * libsyslogtest is built the way a third party extension would be: with
+ * -DUSE_SYSLOG_STUBS, linked to the stub library and calling the C
+ * interface only through the stubs table. It's loaded by the test suite
+ * after the syslog package and creates
+ *
+ *      ::syslogtest::log level ?facility? message
+ *          Syslog_Log, returns its result code
+ *      ::syslogtest::enabled level
+ *          Syslog_Enabled
+ *      ::syslogtest::logger facility format level message
+ *          Syslog_LoggerCreate, Syslog_LoggerLog and Syslog_LoggerDelete
+ *      ::syslogtest::fork script
+ *          forks a child process evaluating script and returns its exit
+ *          status: the integer result of script, 1 when it fails
+ *
+ * Levels and facilities are the numeric LOG_* codes of <syslog.h>
+ */
+
+#include <errno.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#include "../unix/tclSyslog.h"
+
+static int SyslogTestLogCmd (ClientData clientData,Tcl_Interp* interp,int objc,Tcl_Obj *const objv[])
+{
+    int         level;
+    int         facility = -1;
+    int         length;
+    const char* message;
+
+    if ((objc != 3) && (objc != 4)) {
+        Tcl_WrongNumArgs(interp,1,objv,"level ?facility? message");
+        return TCL_ERROR;
+    }
+    if ((Tcl_GetIntFromObj(interp,objv[1],&level) != TCL_OK) ||
+        ((objc == 4) && (Tcl_GetIntFromObj(interp,objv[2],&facility) != TCL_OK))) {
+        return TCL_ERROR;
+    }
+    message = Tcl_GetStringFromObj(objv[objc-1],&length);
+    Tcl_SetObjResult(interp,Tcl_NewIntObj(Syslog_Log(level,facility,message,(size_t) length)));
+    return TCL_OK;
+}
+
+static int SyslogTestEnabledCmd (ClientData clientData,Tcl_Interp* interp,int objc,Tcl_Obj *const objv[])
+{
+    int level;
+
+    if (objc != 2) {
+        Tcl_WrongNumArgs(interp,1,objv,"level");
+        return TCL_ERROR;
+    }
+    if (Tcl_GetIntFromObj(interp,objv[1],&level) != TCL_OK) {
+        return TCL_ERROR;
+    }
+    Tcl_SetObjResult(interp,Tcl_NewIntObj(Syslog_Enabled(level)));
+    return TCL_OK;
+}
+
+static int SyslogTestLoggerCmd (ClientData clientData,Tcl_Interp* interp,int objc,Tcl_Obj *const objv[])
+{
+    Syslog_Logger*  logger;
+    int             facility;
+    int             level;
+    int             length;
+    const char*     message;
+    int             result;
+
+    if (objc != 5) {
+        Tcl_WrongNumArgs(interp,1,objv,"facility format level message");
+        return TCL_ERROR;
+    }
+    if ((Tcl_GetIntFromObj(interp,objv[1],&facility) != TCL_OK) ||
+        (Tcl_GetIntFromObj(interp,objv[3],&level) != TCL_OK)) {
+        return TCL_ERROR;
+    }
+    logger = Syslog_LoggerCreate(facility,Tcl_GetString(objv[2]));
+    if (logger == NULL) {
+        Tcl_SetObjResult(interp,Tcl_NewStringObj("couldn't create the logger",-1));
+        return TCL_ERROR;
+    }
+    message = Tcl_GetStringFromObj(objv[4],&length);
+    result = Syslog_LoggerLog(logger,level,message,(size_t) length);
+    Syslog_LoggerDelete(logger);
+    Tcl_SetObjResult(interp,Tcl_NewIntObj(result));
+    return TCL_OK;
+}
+
+static int SyslogTestForkCmd (ClientData clientData,Tcl_Interp* interp,int objc,Tcl_Obj *const objv[])
+{
+    pid_t   pid;
+    int     status;
+
+    if (objc != 2) {
+        Tcl_WrongNumArgs(interp,1,objv,"script");
+        return TCL_ERROR;
+    }
+    pid = fork();
+    if (pid < 0) {
+        Tcl_SetObjResult(interp,Tcl_ObjPrintf("couldn't fork: %s",Tcl_PosixError(interp)));
+        return TCL_ERROR;
+    }
+    if (pid == 0) {
+        int code = 1;
+
+        if (Tcl_EvalObjEx(interp,objv[1],TCL_EVAL_GLOBAL) == TCL_OK) {
+            Tcl_GetIntFromObj(NULL,Tcl_GetObjResult(interp),&code);
+        }
+        _exit(code);
+    }
+    while (waitpid(pid,&status,0) < 0) {
+        if (errno != EINTR) {
+            Tcl_SetObjResult(interp,Tcl_ObjPrintf("couldn't wait for the child: %s",Tcl_PosixError(interp)));
+            return TCL_ERROR;
+        }
+    }
+    Tcl_SetObjResult(interp,Tcl_NewIntObj(WIFEXITED(status) ? WEXITSTATUS(status) : -1));
+    return TCL_OK;
+}
+
+int Syslogtest_Init (Tcl_Interp* interp)
+{
+    if (Tcl_InitStubs(interp,"8.6-10",0) == NULL) {
+        return TCL_ERROR;
+    }
+    if (Syslog_InitStubs(interp,"2.0",0) == NULL) {
+        return TCL_ERROR;
+    }
+    Tcl_CreateObjCommand(interp,"::syslogtest::log",SyslogTestLogCmd,NULL,NULL);
+    Tcl_CreateObjCommand(interp,"::syslogtest::enabled",SyslogTestEnabledCmd,NULL,NULL);
+    Tcl_CreateObjCommand(interp,"::syslogtest::logger",SyslogTestLoggerCmd,NULL,NULL);
+    Tcl_CreateObjCommand(interp,"::syslogtest::fork",SyslogTestForkCmd,NULL,NULL);
+    return Tcl_PkgProvide(interp,"syslogtest","1.0");
+}
@@ -1,8 +1,26 @@
+#!/usr/bin/tclsh
+#
+# threading.tcl - multi-threaded logging throughput
+#
+# Every thread of a pool of -threads threads logs -messages messages
+# as fast as it can. The run is repeated for every number of transport
+# connections listed in -connections and the time taken by the pool and
+# the number of records delivered to the test sink are reported
+#
+#   tclsh threading.tcl ?-threads 32? ?-messages 2000? ?-connections {1 4 16}?
+#
+
 package require Tcl
 package require Thread
 
+set current_script_path [file dirname [file normalize [info script]]]
 set auto_path [concat "." ".." $auto_path]
-package require syslog 2.0.0
+package require syslog
+
+source [file join $current_script_path harness.tcl]
+
+array set opts {-threads 32 -messages 2000 -connections {1 4 16}}
+array set opts $argv
 
 proc broadcast {cmd} {
     foreach t [array names ::thread_pool] {
@@ -10,36 +28,48 @@ proc broadcast {cmd} {
     }
 }
 
-::syslog::open -ident test -pid
+::syslogtest::harness::start 7000 sink
+::syslog::open -ident test -pid -socket [::syslogtest::harness::socket_path]
 
-set n -1
-while {$n < 20} {
-    set thread_n [incr n]
-    set thread_pool($thread_n) [::thread::create {
+for {set n 0} {$n < $opts(-threads)} {incr n} {
+    set thread_pool($n) [::thread::create {
         set auto_path [concat "." ".." $auto_path]
-        package require syslog 2.0.0
-
-        set nlog_msg      0
-        set batch         10
-        set nlog_in_batch 0
-        proc log_message {} {
-            ::syslog::log info "\[[::thread::id]\] logging msg [incr ::nlog_msg]"
-            if {$::nlog_in_batch > $::batch} {
-                set ::nlog_in_batch 0
-            } else {
-                incr ::nlog_in_batch
-                after 50 log_message
-            }
-        }
+        package require syslog
 
-        proc start_logging {} {
-            after 50 log_message
+        proc log_messages {nmessages main_thread} {
+            set start [clock microseconds]
+            for {set i 0} {$i < $nmessages} {incr i} {
+                ::syslog::log info "\[[::thread::id]\] logging msg $i"
+            }
+            ::thread::send -async $main_thread [list lappend ::elapsed [expr {[clock microseconds] - $start}]]
         }
-        ::syslog::log info "\[[::thread::id]\] posed to wait for command"
 
         ::thread::wait
     }]
 
-    ::thread::preserve $thread_pool($thread_n)
+    ::thread::preserve $thread_pool($n)
 }
 
+puts [format "%-12s %-8s %-10s %-12s %-12s %-10s" connections threads messages elapsed(ms) msgs/s delivered]
+foreach connections $opts(-connections) {
+    ::syslog::open -connections $connections
+    ::syslogtest::harness::reset
+
+    set expected [expr {$opts(-threads) * $opts(-messages)}]
+    set elapsed  {}
+    set start    [clock microseconds]
+    broadcast [list log_messages $opts(-messages) [::thread::id]]
+    while {[llength $elapsed] < $opts(-threads)} {
+        vwait elapsed
+    }
+    set wallclock [expr {[clock microseconds] - $start}]
+    set delivered [::syslogtest::harness::delivered $expected 60000]
+
+    puts [format "%-12d %-8d %-10d %-12.1f %-12.0f %-10d" $connections $opts(-threads) $expected \
+                 [expr {$wallclock / 1000.0}] [expr {$expected * 1e6 / $wallclock}] $delivered]
+}
+
+foreach t [array names thread_pool] {
+    ::thread::release $thread_pool($t)
+}
+::syslogtest::harness::stop
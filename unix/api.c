@@ -0,0 +1,163 @@
+/*
+ *    api.c - C interface for the extensions loaded in the process
+ *
+ *    A Tcl interface to the POSIX syslog service.
+ *
+ *    Copyright (C) 2026 Massimo Manghi <mxmanghi@apache.org>
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * The functions exported by the stubs table (see syslog.decls and
+ * tclSyslog.h). Messages go through log_message like those of
+ * ::syslog::log: same threshold, transport, queue or ring.
+ *
+ * Syslog_Log uses the status of the calling thread, so the message gets
+ * the thread context and -escape mode, but not the level, facility and
+ * format of the last ::syslog::log call, which are preserved. A
+ * Syslog_Logger has a status of its own like the channels created by
+ * ::syslog::channel
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <limits.h>
+#include <string.h>
+#include <syslog.h>
+
+#include "syslog.h"
+#include "tclSyslog.h"
+
+struct Syslog_Logger {
+    SyslogThreadStatus status;
+};
+
+extern char* g_default_format;
+
+static bool valid_level (int level)
+{
+    return (level >= LOG_EMERG) && (level <= LOG_DEBUG);
+}
+
+static bool valid_facility (int facility)
+{
+    return (facility < 0) || ((facility & ~LOG_FACMASK) == 0);
+}
+
+/*
+ * Syslog_Enabled
+ *
+ * Returned value: 1 if a message of the given level would be logged,
+ * 0 if it would be discarded by the -threshold in effect. Building a
+ * message that is then discarded can be skipped
+ */
+
+int Syslog_Enabled (int level)
+{
+    return threshold_enabled(level) ? 1 : 0;
+}
+
+/*
+ * Syslog_Log
+ *
+ * Logs length bytes of message with the given level and facility
+ * (< 0: the facility set with ::syslog::open)
+ *
+ * Returned value: TCL_OK or TCL_ERROR (invalid level or facility,
+ * message not delivered)
+ */
+
+int Syslog_Log (int level,int facility,const char* message,size_t length)
+{
+    SyslogThreadStatus* status;
+    int                 saved_level;
+    int                 saved_facility;
+    const char*         saved_format;
+    int                 result;
+
+    if (!valid_level(level) || !valid_facility(facility) || (length > INT_MAX)) {
+        return TCL_ERROR;
+    }
+    if (!threshold_enabled(level)) {
+        return TCL_OK;
+    }
+
+    status          = get_thread_status();
+    saved_level     = status->level;
+    saved_facility  = status->facility;
+    saved_format    = status->format;
+
+    status->level         = level;
+    status->facility      = facility;
+    status->format        = g_default_format;
+    status->message       = (char *) message;
+    status->message_len   = (int) length;
+    status->is_structured = false;
+    result = (log_message(status) == TCL_OK) ? TCL_OK : TCL_ERROR;
+
+    status->level    = saved_level;
+    status->facility = saved_facility;
+    status->format   = saved_format;
+    return result;
+}
+
+/*
+ * Syslog_LoggerCreate
+ *
+ * Returns a new logger with the given facility and format (NULL: no
+ * format). The format is applied as ::syslog::log -format does with
+ * a single message argument
+ */
+
+Syslog_Logger* Syslog_LoggerCreate (int facility,const char* format)
+{
+    Syslog_Logger* logger;
+
+    if (!valid_facility(facility)) {
+        return NULL;
+    }
+
+    logger = (Syslog_Logger *) Tcl_Alloc(sizeof(Syslog_Logger));
+    memset(logger,0,sizeof(Syslog_Logger));
+    SyslogInitStatus(&logger->status);
+    logger->status.facility = facility;
+    if (format != NULL) {
+        logger->status.format = intern_acquire_format(format);
+    }
+    return logger;
+}
+
+int Syslog_LoggerLog (Syslog_Logger* logger,int level,const char* message,size_t length)
+{
+    if (!valid_level(level) || (length > INT_MAX)) {
+        return TCL_ERROR;
+    }
+    if (!threshold_enabled(level)) {
+        return TCL_OK;
+    }
+
+    logger->status.level       = level;
+    logger->status.message     = (char *) message;
+    logger->status.message_len = (int) length;
+    return (log_message(&logger->status) == TCL_OK) ? TCL_OK : TCL_ERROR;
+}
+
+void Syslog_LoggerDelete (Syslog_Logger* logger)
+{
+    SyslogFinalizeStatus((ClientData) &logger->status);
+    Tcl_Free((char *) logger);
+}
@@ -0,0 +1,285 @@
+/*
+ *    bench.c - native benchmark of the logging path
+ *
+ *    A Tcl interface to the POSIX syslog service.
+ *
+ *    Copyright (C) 2026 Massimo Manghi <mxmanghi@apache.org>
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * ::syslog::bench runs native threads calling log_message in a loop,
+ * timing every call. No Tcl command is evaluated while measuring, the
+ * figures only account for rendering, locking and the transport. The
+ * records go wherever ::syslog::open sent them (-socket, -connections,
+ * -queue...)
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syslog.h>
+#include <time.h>
+
+#include "syslog.h"
+#include "transport.h"
+#include "queue.h"
+#include "ring.h"
+
+#define BENCH_MAX_THREADS   256
+#define BENCH_MAX_SAMPLES   (10 * 1000 * 1000)
+#define BENCH_DRAIN_MS      10000   /* longest wait for the queue and the ring to drain */
+
+typedef struct BenchThread {
+    int             messages;
+    int             size;
+    int             level;
+    uint64_t*       samples;    /* nanoseconds taken by every log_message call */
+    Tcl_ThreadId    thread_id;
+} BenchThread;
+
+static uint64_t bench_now (void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC,&ts);
+    return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static int bench_compare (const void* a,const void* b)
+{
+    uint64_t x = *(const uint64_t *) a;
+    uint64_t y = *(const uint64_t *) b;
+
+    return (x > y) - (x < y);
+}
+
+static Tcl_ThreadCreateType bench_thread (ClientData clientData)
+{
+    BenchThread*        bench = (BenchThread *) clientData;
+    SyslogThreadStatus  status;
+    char*               message = Tcl_Alloc(bench->size + 1);
+    int                 i;
+
+    memset(&status,0,sizeof(status));
+    SyslogInitStatus(&status);
+    status.level = bench->level;
+
+    memset(message,'x',bench->size);
+    memcpy(message,"syslog bench ",(bench->size < 13) ? bench->size : 13);
+    message[bench->size] = '\0';
+
+    for (i = 0; i < bench->messages; i++) {
+        uint64_t start = bench_now();
+
+        status.message     = message;
+        status.message_len = bench->size;
+        if (threshold_enabled(status.level)) {
+            log_message(&status);
+        }
+        bench->samples[i] = bench_now() - start;
+    }
+
+    SyslogFinalizeStatus((ClientData) &status);
+    Tcl_Free(message);
+#ifdef TCL_THREADS
+    Tcl_FinalizeThread();
+#endif
+    TCL_THREAD_CREATE_RETURN;
+}
+
+/*
+ * bench_drain
+ *
+ * Waits (at most BENCH_DRAIN_MS) until the records logged have gone
+ * through the transport: the -queue writer has sent every record queued
+ * and the -ring collectors the records written in the ring so far
+ */
+
+static void bench_drain (void)
+{
+    struct timespec pause = { 0, 1000000 };
+    uint64_t        deadline = bench_now() + (uint64_t) BENCH_DRAIN_MS * 1000000ULL;
+    Tcl_WideInt     written = ring_written();
+
+    while ((!queue_idle() || !ring_collected(written)) && (bench_now() < deadline)) {
+        nanosleep(&pause,NULL);
+    }
+}
+
+static Tcl_Obj* bench_percentile (uint64_t* sorted,long count,double p)
+{
+    long index = (long) (p * (count - 1) + 0.5);
+
+    return Tcl_NewWideIntObj((Tcl_WideInt) sorted[index]);
+}
+
+/*
+ * SyslogBenchCmd
+ *
+ *  ::syslog::bench ?-messages n? ?-threads n? ?-size bytes? ?-level level?
+ *
+ * Every thread logs -messages records of -size bytes. Returns a dictionary
+ * with the wall clock time, the throughput in messages per second, the
+ * number of records that couldn't be sent (dropped) and the distribution
+ * of the time taken by a single call (ns_per_op: min, mean, percentiles
+ * and max). 'dropped' is the growth of the transport counter during the
+ * run: it takes in the records dropped by the writer thread of -queue
+ * and by the ring collector as well as those sent directly. The counter
+ * is sampled once the queue and the ring are drained (bench_drain), the
+ * elapsed time stops when the logging threads are done
+ */
+
+int SyslogBenchCmd (ClientData clientData,Tcl_Interp *interp,int objc,Tcl_Obj *CONST86 objv[])
+{
+    static const char* bench_options[] = { "-messages", "-threads", "-size", "-level", NULL };
+    enum { BENCH_MESSAGES, BENCH_THREADS, BENCH_SIZE, BENCH_LEVEL };
+
+    int             messages = 10000;
+    int             nthreads = 1;
+    int             size     = 64;
+    int             level    = LOG_INFO;
+    BenchThread*    threads;
+    uint64_t*       samples;
+    uint64_t        start,elapsed;
+    uint64_t        total = 0;
+    long            nsamples;
+    Tcl_WideInt     dropped;
+#ifdef TCL_THREADS
+    int             started;
+#endif
+    int             i;
+
+    if ((objc % 2) == 0) {
+        Tcl_WrongNumArgs(interp,1,objv,"?-messages n? ?-threads n? ?-size bytes? ?-level level?");
+        return TCL_ERROR;
+    }
+
+    for (i = 1; i < objc; i += 2) {
+        int option;
+        int value;
+
+        if (Tcl_GetIndexFromObj(interp,objv[i],bench_options,"option",0,&option) != TCL_OK) {
+            return TCL_ERROR;
+        }
+        if (option == BENCH_LEVEL) {
+            if ((level = level_cli_to_code(interp,Tcl_GetString(objv[i+1]))) == ERROR) {
+                return TCL_ERROR;
+            }
+            continue;
+        }
+        if (Tcl_GetIntFromObj(interp,objv[i+1],&value) != TCL_OK) {
+            return TCL_ERROR;
+        }
+        switch (option) {
+            case BENCH_MESSAGES: messages = value; break;
+            case BENCH_THREADS:  nthreads = value; break;
+            case BENCH_SIZE:     size     = value; break;
+        }
+    }
+
+#ifdef TCL_THREADS
+    if ((nthreads < 1) || (nthreads > BENCH_MAX_THREADS)) {
+        Tcl_SetObjResult(interp,Tcl_ObjPrintf("Invalid -threads value %d (must be between 1 and %d)",
+                                              nthreads,BENCH_MAX_THREADS));
+        return TCL_ERROR;
+    }
+#else
+    if (nthreads != 1) {
+        Tcl_SetObjResult(interp,Tcl_NewStringObj("-threads must be 1 without thread support",-1));
+        return TCL_ERROR;
+    }
+#endif
+    if ((messages < 1) || ((long) messages * nthreads > BENCH_MAX_SAMPLES)) {
+        Tcl_SetObjResult(interp,Tcl_ObjPrintf("Invalid -messages value %d (at most %d messages in total)",
+                                              messages,BENCH_MAX_SAMPLES));
+        return TCL_ERROR;
+    }
+    if (size < 1) {
+        Tcl_SetObjResult(interp,Tcl_ObjPrintf("Invalid -size value %d",size));
+        return TCL_ERROR;
+    }
+
+    nsamples = (long) messages * nthreads;
+    samples  = (uint64_t *) Tcl_Alloc(nsamples * sizeof(uint64_t));
+    threads  = (BenchThread *) Tcl_Alloc(nthreads * sizeof(BenchThread));
+    for (i = 0; i < nthreads; i++) {
+        threads[i].messages = messages;
+        threads[i].size     = size;
+        threads[i].level    = level;
+        threads[i].samples  = samples + (long) i * messages;
+    }
+
+    dropped = transport_dropped();
+    start = bench_now();
+#ifdef TCL_THREADS
+    for (started = 0; started < nthreads; started++) {
+        if (Tcl_CreateThread(&threads[started].thread_id,bench_thread,(ClientData) &threads[started],
+                             TCL_THREAD_STACK_DEFAULT,TCL_THREAD_JOINABLE) != TCL_OK) {
+            break;
+        }
+    }
+
+    /* only the threads actually started are joined */
+
+    for (i = 0; i < started; i++) {
+        int result;
+        Tcl_JoinThread(threads[i].thread_id,&result);
+    }
+    if (started < nthreads) {
+        Tcl_Free((char *) threads);
+        Tcl_Free((char *) samples);
+        Tcl_SetObjResult(interp,Tcl_ObjPrintf("couldn't create bench thread %d of %d",started + 1,nthreads));
+        return TCL_ERROR;
+    }
+#else
+    bench_thread((ClientData) &threads[0]);
+#endif
+    elapsed = bench_now() - start;
+    bench_drain();
+    dropped = transport_dropped() - dropped;
+
+    qsort(samples,nsamples,sizeof(uint64_t),bench_compare);
+    for (i = 0; i < nsamples; i++) {
+        total += samples[i];
+    }
+
+    Tcl_Obj* ns_per_op = Tcl_NewDictObj();
+    Tcl_DictObjPut(NULL,ns_per_op,Tcl_NewStringObj("min",-1),Tcl_NewWideIntObj((Tcl_WideInt) samples[0]));
+    Tcl_DictObjPut(NULL,ns_per_op,Tcl_NewStringObj("mean",-1),Tcl_NewWideIntObj((Tcl_WideInt) (total / nsamples)));
+    Tcl_DictObjPut(NULL,ns_per_op,Tcl_NewStringObj("p50",-1),bench_percentile(samples,nsamples,0.50));
+    Tcl_DictObjPut(NULL,ns_per_op,Tcl_NewStringObj("p90",-1),bench_percentile(samples,nsamples,0.90));
+    Tcl_DictObjPut(NULL,ns_per_op,Tcl_NewStringObj("p99",-1),bench_percentile(samples,nsamples,0.99));
+    Tcl_DictObjPut(NULL,ns_per_op,Tcl_NewStringObj("p999",-1),bench_percentile(samples,nsamples,0.999));
+    Tcl_DictObjPut(NULL,ns_per_op,Tcl_NewStringObj("max",-1),Tcl_NewWideIntObj((Tcl_WideInt) samples[nsamples-1]));
+
+    Tcl_Obj* result = Tcl_NewDictObj();
+    Tcl_DictObjPut(NULL,result,Tcl_NewStringObj("messages",-1),Tcl_NewWideIntObj((Tcl_WideInt) nsamples));
+    Tcl_DictObjPut(NULL,result,Tcl_NewStringObj("threads",-1),Tcl_NewIntObj(nthreads));
+    Tcl_DictObjPut(NULL,result,Tcl_NewStringObj("size",-1),Tcl_NewIntObj(size));
+    Tcl_DictObjPut(NULL,result,Tcl_NewStringObj("elapsed_us",-1),Tcl_NewWideIntObj((Tcl_WideInt) (elapsed / 1000)));
+    Tcl_DictObjPut(NULL,result,Tcl_NewStringObj("throughput",-1),Tcl_NewDoubleObj(nsamples * 1e9 / (elapsed ? elapsed : 1)));
+    Tcl_DictObjPut(NULL,result,Tcl_NewStringObj("dropped",-1),Tcl_NewWideIntObj(dropped));
+    Tcl_DictObjPut(NULL,result,Tcl_NewStringObj("ns_per_op",-1),ns_per_op);
+
+    Tcl_Free((char *) threads);
+    Tcl_Free((char *) samples);
+    Tcl_SetObjResult(interp,result);
+    return TCL_OK;
+}
@@ -0,0 +1,291 @@
+/*
+ *    channel.c - syslog as a Tcl channel type
+ *
+ *    A Tcl interface to the POSIX syslog service.
+ *
+ *    Copyright (C) 2026 Massimo Manghi <mxmanghi@apache.org>
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * ::syslog::channel returns a write-only channel where every line
+ * written becomes a syslog record. The channel buffering coalesces
+ * the writes and the output procedure splits the buffer it gets into
+ * lines, so that 'chan copy' from a pipe or a redirected stderr can log
+ * without a Tcl command dispatch per line.
+ *
+ * Every channel has its own SyslogThreadStatus: level, facility and
+ * format of a channel are independent of those set by ::syslog::log
+ * and can be changed with 'chan configure'
+ *
+ * A line not yet terminated is kept in a buffer waiting for its newline.
+ * Output with no newline at all (a binary stream, a progress bar) would
+ * grow the buffer without limit: once it holds more than -maxsize bytes (or
+ * CHANNEL_MAX_LINE when -maxsize is not set) they are logged as a record
+ * of their own, cut on a UTF-8 character boundary
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <syslog.h>
+
+#include "syslog.h"
+#include "params.h"
+
+/* longest unterminated line kept waiting for its newline with no -maxsize */
+
+#define CHANNEL_MAX_LINE    8192
+
+extern SyslogGlobalStatus *g_status;
+
+typedef struct SyslogChannel {
+    Tcl_Channel         channel;
+    SyslogThreadStatus  status;
+    Tcl_DString         partial;    /* last line written without its newline */
+} SyslogChannel;
+
+static int  SyslogChannelClose (ClientData instanceData,Tcl_Interp *interp,int flags);
+static int  SyslogChannelInput (ClientData instanceData,char *buf,int toRead,int *errorCodePtr);
+static int  SyslogChannelOutput (ClientData instanceData,const char *buf,int toWrite,int *errorCodePtr);
+static int  SyslogChannelSetOption (ClientData instanceData,Tcl_Interp *interp,const char *optionName,const char *value);
+static int  SyslogChannelGetOption (ClientData instanceData,Tcl_Interp *interp,const char *optionName,Tcl_DString *dsPtr);
+static void SyslogChannelWatch (ClientData instanceData,int mask);
+static int  SyslogChannelGetHandle (ClientData instanceData,int direction,ClientData *handlePtr);
+
+static Tcl_ChannelType syslogChannelType = {
+    "syslog",                   /* typeName */
+    TCL_CHANNEL_VERSION_5,      /* version */
+    TCL_CLOSE2PROC,             /* closeProc */
+    SyslogChannelInput,         /* inputProc */
+    SyslogChannelOutput,        /* outputProc */
+    NULL,                       /* seekProc */
+    SyslogChannelSetOption,     /* setOptionProc */
+    SyslogChannelGetOption,     /* getOptionProc */
+    SyslogChannelWatch,         /* watchProc */
+    SyslogChannelGetHandle,     /* getHandleProc */
+    SyslogChannelClose,         /* close2Proc */
+    NULL,                       /* blockModeProc */
+    NULL,                       /* flushProc */
+    NULL,                       /* handlerProc */
+    NULL,                       /* wideSeekProc */
+    NULL,                       /* threadActionProc */
+    NULL                        /* truncateProc */
+};
+
+/*
+ * log_line
+ *
+ * Sends a line, the trailing carriage return of CRLF terminated
+ * lines is removed. Empty lines are not logged
+ */
+
+static void log_line (SyslogChannel* chan,const char* line,int length)
+{
+    if ((length > 0) && (line[length-1] == '\r')) { length--; }
+    if ((length == 0) || !threshold_enabled(chan->status.level)) { return; }
+
+    chan->status.message     = (char *) line;
+    chan->status.message_len = length;
+    log_message(&chan->status);
+}
+
+/*
+ * log_partial
+ *
+ * Logs the first max_line bytes of the partial buffer, stepping back
+ * to the start of a UTF-8 character, and keeps the rest. The buffer
+ * must be longer than max_line: the byte following the cut tells
+ * whether it splits a character
+ */
+
+static void log_partial (SyslogChannel* chan,int max_line)
+{
+    char*   text   = Tcl_DStringValue(&chan->partial);
+    int     total  = Tcl_DStringLength(&chan->partial);
+    int     length = max_line;
+
+    while ((length > 0) && ((text[length] & 0xC0) == 0x80)) { length--; }
+    if (length == 0) { length = max_line; }
+
+    log_line(chan,text,length);
+    memmove(text,text + length,total - length);
+    Tcl_DStringSetLength(&chan->partial,total - length);
+}
+
+static int SyslogChannelOutput (ClientData instanceData,const char *buf,int toWrite,int *errorCodePtr)
+{
+    SyslogChannel*  chan = (SyslogChannel *) instanceData;
+    const char*     end  = buf + toWrite;
+    const char*     line = buf;
+    const char*     newline;
+
+    while ((newline = memchr(line,'\n',end - line)) != NULL) {
+
+        /* a line started by a previous write is completed in the partial buffer */
+
+        if (Tcl_DStringLength(&chan->partial) > 0) {
+            Tcl_DStringAppend(&chan->partial,line,newline - line);
+            log_line(chan,Tcl_DStringValue(&chan->partial),Tcl_DStringLength(&chan->partial));
+            Tcl_DStringSetLength(&chan->partial,0);
+        } else {
+            log_line(chan,line,newline - line);
+        }
+        line = newline + 1;
+    }
+
+    if (line < end) {
+        int max_line = SYSLOG_ATOMIC_LOAD(g_status->max_size);
+
+        if (max_line <= 0) { max_line = CHANNEL_MAX_LINE; }
+        Tcl_DStringAppend(&chan->partial,line,end - line);
+        while (Tcl_DStringLength(&chan->partial) > max_line) {
+            log_partial(chan,max_line);
+        }
+    }
+    return toWrite;
+}
+
+static int SyslogChannelInput (ClientData instanceData,char *buf,int toRead,int *errorCodePtr)
+{
+    *errorCodePtr = EINVAL;
+    return -1;
+}
+
+static int SyslogChannelClose (ClientData instanceData,Tcl_Interp *interp,int flags)
+{
+    SyslogChannel* chan = (SyslogChannel *) instanceData;
+
+    if ((flags & (TCL_CLOSE_READ|TCL_CLOSE_WRITE)) != 0) {
+        return EINVAL;
+    }
+
+    /* the last line is logged even if it wasn't terminated */
+
+    if (Tcl_DStringLength(&chan->partial) > 0) {
+        log_line(chan,Tcl_DStringValue(&chan->partial),Tcl_DStringLength(&chan->partial));
+    }
+    Tcl_DStringFree(&chan->partial);
+    SyslogFinalizeStatus((ClientData) &chan->status);
+    Tcl_Free((char *) chan);
+    return 0;
+}
+
+static void SyslogChannelWatch (ClientData instanceData,int mask)
+{
+    /* there are no events to watch on a syslog channel */
+}
+
+static int SyslogChannelGetHandle (ClientData instanceData,int direction,ClientData *handlePtr)
+{
+    return TCL_ERROR;
+}
+
+static int SyslogChannelSetOption (ClientData instanceData,Tcl_Interp *interp,const char *optionName,const char *value)
+{
+    SyslogChannel* chan = (SyslogChannel *) instanceData;
+
+    if ((strcmp(optionName,"-level") == 0) || (strcmp(optionName,"-priority") == 0)) {
+        int level = level_cli_to_code(interp,value);
+        if (level == ERROR) { return TCL_ERROR; }
+        chan->status.level = level;
+        return TCL_OK;
+    } else if (strcmp(optionName,"-facility") == 0) {
+        int facility = facility_cli_to_code(interp,value);
+        if (facility == ERROR) { return TCL_ERROR; }
+        chan->status.facility = facility;
+        return TCL_OK;
+    }
+    return Tcl_BadChannelOption(interp,optionName,"facility level");
+}
+
+static int SyslogChannelGetOption (ClientData instanceData,Tcl_Interp *interp,const char *optionName,Tcl_DString *dsPtr)
+{
+    SyslogChannel*  chan = (SyslogChannel *) instanceData;
+    const char*     facility = (chan->status.facility >= 0) ? facility_code_to_cli(chan->status.facility) : "";
+    const char*     level = level_code_to_cli(chan->status.level);
+
+    if (optionName == NULL) {
+        Tcl_DStringAppendElement(dsPtr,"-facility");
+        Tcl_DStringAppendElement(dsPtr,facility);
+        Tcl_DStringAppendElement(dsPtr,"-level");
+        Tcl_DStringAppendElement(dsPtr,level);
+        return TCL_OK;
+    } else if (strcmp(optionName,"-facility") == 0) {
+        Tcl_DStringAppend(dsPtr,facility,-1);
+        return TCL_OK;
+    } else if ((strcmp(optionName,"-level") == 0) || (strcmp(optionName,"-priority") == 0)) {
+        Tcl_DStringAppend(dsPtr,level,-1);
+        return TCL_OK;
+    }
+    return Tcl_BadChannelOption(interp,optionName,"facility level");
+}
+
+/*
+ * SyslogChannelCmd
+ *
+ *  ::syslog::channel ?-level level? ?-facility facility? ?-format format?
+ *
+ * Returns the name of a new write-only channel. The channel has full
+ * buffering and utf-8 encoding
+ */
+
+int SyslogChannelCmd (ClientData clientData,Tcl_Interp *interp,int objc,Tcl_Obj *CONST86 objv[])
+{
+    static unsigned long channel_id = 0;
+
+    SyslogChannel*      chan = (SyslogChannel *) Tcl_Alloc(sizeof(SyslogChannel));
+    ParseArgsOptions    pao;
+    char                channel_name[32];
+
+    memset(chan,0,sizeof(SyslogChannel));
+    SyslogInitStatus(&chan->status);
+    Tcl_DStringInit(&chan->partial);
+
+    pao.status              = &chan->status;
+    pao.last_option_index   = 0;
+    pao.unhandled_opt_index = 0;
+    pao.option_class        = PER_THREAD_OPTION_CLASS;
+    pao.modified_opt_class  = 0;
+    pao.facility_is_private = true;
+    pao.json                = NULL;
+    pao.cee                 = false;
+
+    if ((parse_options(interp,objc,objv,&pao) < 0) || (pao.last_option_index != objc-1)) {
+        if (pao.unhandled_opt_index > 0) {
+            Tcl_SetObjResult(interp,Tcl_ObjPrintf("Invalid option '%s'",Tcl_GetString(objv[pao.unhandled_opt_index])));
+        } else if (pao.last_option_index != objc-1) {
+            Tcl_WrongNumArgs(interp,1,objv,"?-level level? ?-facility facility? ?-format format?");
+        }
+        Tcl_DStringFree(&chan->partial);
+        SyslogFinalizeStatus((ClientData) &chan->status);
+        Tcl_Free((char *) chan);
+        return TCL_ERROR;
+    }
+
+    snprintf(channel_name,sizeof(channel_name),"syslog%lu",SYSLOG_ATOMIC_INCR(channel_id));
+    chan->channel = Tcl_CreateChannel(&syslogChannelType,channel_name,(ClientData) chan,TCL_WRITABLE);
+    Tcl_RegisterChannel(interp,chan->channel);
+    Tcl_SetChannelOption(interp,chan->channel,"-encoding","utf-8");
+    Tcl_SetChannelOption(interp,chan->channel,"-translation","lf");
+    Tcl_SetChannelOption(interp,chan->channel,"-buffering","full");
+
+    Tcl_SetObjResult(interp,Tcl_NewStringObj(channel_name,-1));
+    return TCL_OK;
+}
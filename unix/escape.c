@@ -0,0 +1,136 @@
+/*
+ *    escape.c - escaping of control characters in log messages
+ *
+ *    A Tcl interface to the POSIX syslog service.
+ *
+ *    Copyright (C) 2026 Massimo Manghi <mxmanghi@apache.org>
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Syslog daemons split records on newlines or mangle control characters
+ * in their own ways. With -escape octal|json we escape them before
+ * sending. Messages rarely contain anything to escape, so the scanner
+ * checks 8 bytes at a time and a clean message is sent as it is.
+ *
+ * Besides the ASCII control characters (0x00-0x1f and 0x7f) the scanner
+ * stops on 0xC0, the lead byte of the Tcl internal encoding of U+0000
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include "syslog.h"
+
+#define ONES            0x0101010101010101ULL
+#define HIGHS           0x8080808080808080ULL
+
+/* bit tricks from 'Bit Twiddling Hacks': a byte of x is < n (n <= 128), a byte of x is 0 */
+
+#define HAS_LESS(x,n)   (((x) - ONES * (n)) & ~(x) & HIGHS)
+#define HAS_ZERO(x)     (((x) - ONES) & ~(x) & HIGHS)
+#define HAS_BYTE(x,b)   HAS_ZERO((x) ^ (ONES * (b)))
+
+static const char hex_digits[] = "0123456789abcdef";
+
+static inline bool escape_byte (unsigned char c)
+{
+    return (c < 0x20) || (c == 0x7f) || (c == 0xC0);
+}
+
+/*
+ * escape_scan
+ *
+ * Returns the offset of the first byte that might need escaping,
+ * or length when there is none
+ */
+
+int escape_scan (const char* text,int length)
+{
+    const unsigned char* p   = (const unsigned char *) text;
+    const unsigned char* end = p + length;
+
+    while (end - p >= 8) {
+        uint64_t word;
+
+        memcpy(&word,p,sizeof(word));
+        if (HAS_LESS(word,0x20) | HAS_BYTE(word,0x7f) | HAS_BYTE(word,0xC0)) {
+            break;
+        }
+        p += 8;
+    }
+
+    while ((p < end) && !escape_byte(*p)) { p++; }
+    return (int) (p - (const unsigned char *) text);
+}
+
+/*
+ * escape_append
+ *
+ * Appends text to out escaping the control characters. With
+ * ESCAPE_OCTAL they are written as '#ooo' (the rsyslog convention),
+ * with ESCAPE_JSON as in a JSON string ('\n', '\t', '\u001b'...)
+ */
+
+void escape_append (Tcl_DString* out,const char* text,int length,int mode)
+{
+    const char* end = text + length;
+
+    while (text < end) {
+        int             clean = escape_scan(text,end - text);
+        unsigned char   c;
+        char            escape[7];
+        int             escape_len;
+
+        Tcl_DStringAppend(out,text,clean);
+        text += clean;
+        if (text == end) { break; }
+
+        c = (unsigned char) *text++;
+        if (c == 0xC0) {
+            if ((text < end) && ((unsigned char) *text == 0x80)) {
+                text++;
+                c = 0;
+            } else {
+                Tcl_DStringAppend(out,(const char *) &c,1);
+                continue;
+            }
+        }
+
+        if (mode == ESCAPE_OCTAL) {
+            escape[0] = '#';
+            escape[1] = '0' + (c >> 6);
+            escape[2] = '0' + ((c >> 3) & 7);
+            escape[3] = '0' + (c & 7);
+            escape_len = 4;
+        } else {
+            escape[0] = '\\';
+            escape_len = 2;
+            switch (c) {
+                case '\n': escape[1] = 'n'; break;
+                case '\r': escape[1] = 'r'; break;
+                case '\t': escape[1] = 't'; break;
+                case '\b': escape[1] = 'b'; break;
+                case '\f': escape[1] = 'f'; break;
+                default:
+                    memcpy(escape,"\\u00",4);
+                    escape[4] = hex_digits[c >> 4];
+                    escape[5] = hex_digits[c & 0x0f];
+                    escape_len = 6;
+                    break;
+            }
+        }
+        Tcl_DStringAppend(out,escape,escape_len);
+    }
+}
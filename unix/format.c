@@ -0,0 +1,431 @@
+/*
+ *    format.c - compiled -format strings
+ *
+ *    A Tcl interface to the POSIX syslog service.
+ *
+ *    Copyright (C) 2026 Massimo Manghi <mxmanghi@apache.org>
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * A format is parsed once, when it's interned (see intern.c), into a list
+ * of segments: literal text and conversions taking the arguments of
+ * ::syslog::log in order. The supported conversions are those of Tcl's
+ * format with at most 3 digits of width and precision:
+ *
+ *      %s %d %i %u %x %X %o %c %f %F %e %E %g %G and %%
+ *
+ * The size modifiers (h, l, ll...) are accepted and ignored, integers are
+ * always 64 bits. A '%' not starting a valid conversion is copied as it is.
+ * The format string is never handed to the C library: every numeric
+ * conversion is rendered with a snprintf format built here for exactly one
+ * argument of the type the conversion expects. Width and precision of %s
+ * count characters as in Tcl, not bytes, so the strings are padded and
+ * cut here and a multibyte character is never split.
+ *
+ * A format made only of literal text and at most one %s with no flags is
+ * 'plain': the message is sent as a segment of its own with no copy
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "syslog.h"
+#include "format.h"
+
+/*
+ * format_append_literal
+ *
+ * Appends length bytes of text to the literal segment at the end of
+ * the list, creating one if the last segment is a conversion
+ */
+
+static void format_append_literal (CompiledFormat* compiled,int* literals_len,const char* text,int length)
+{
+    FormatSegment* last = NULL;
+
+    if (compiled->nsegments > 0) {
+        last = &compiled->segments[compiled->nsegments - 1];
+    }
+    if ((last == NULL) || (last->type != FORMAT_LITERAL)) {
+        last = &compiled->segments[compiled->nsegments++];
+        last->type   = FORMAT_LITERAL;
+        last->offset = *literals_len;
+        last->length = 0;
+    }
+    memcpy(compiled->literals + *literals_len,text,length);
+    *literals_len += length;
+    last->length  += length;
+}
+
+/*
+ * format_parse_number
+ *
+ * Parses at most 3 digits. Returns the number or -1 when it's
+ * larger than FORMAT_MAX_WIDTH
+ */
+
+static int format_parse_number (const char** p)
+{
+    int value = 0;
+    int digits;
+
+    for (digits = 0; (digits < 3) && (**p >= '0') && (**p <= '9'); digits++, (*p)++) {
+        value = value * 10 + (**p - '0');
+    }
+    return (value > FORMAT_MAX_WIDTH) ? -1 : value;
+}
+
+/*
+ * format_parse_conversion
+ *
+ * Parses the conversion starting at the '%' in p into segment
+ *
+ * Returned value: the number of characters of the conversion,
+ * 0 if p doesn't start a valid conversion
+ */
+
+static int format_parse_conversion (const char* p,FormatSegment* segment)
+{
+    const char* q = p + 1;
+    char        flags[6];
+    int         nflags = 0;
+    int         width = -1;
+    int         precision = -1;
+    int         modifiers;
+    const char* size = "";
+    char*       spec = segment->spec;
+
+    while ((*q != '\0') && (strchr("-+ 0#",*q) != NULL)) {
+        if ((memchr(flags,*q,nflags) == NULL) && (nflags < 5)) {
+            flags[nflags++] = *q;
+        }
+        q++;
+    }
+    if ((*q >= '0') && (*q <= '9')) {
+        if ((width = format_parse_number(&q)) < 0) { return 0; }
+    }
+    if (*q == '.') {
+        q++;
+        if ((precision = format_parse_number(&q)) < 0) { return 0; }
+    }
+    if ((*q >= '0') && (*q <= '9')) { return 0; }
+    for (modifiers = 0; (modifiers < 2) && (*q != '\0') && (strchr("hlLqjzt",*q) != NULL); modifiers++) {
+        q++;
+    }
+
+    segment->conversion = *q;
+    switch (*q) {
+        case 's':
+            if ((nflags == 0) && (width < 0) && (precision < 0)) {
+                segment->type = FORMAT_STRING;
+                return q + 1 - p;
+            }
+
+            /* '-' is the only flag a string conversion has */
+
+            segment->type      = FORMAT_PADDED;
+            segment->width     = width;
+            segment->precision = precision;
+            segment->left      = (memchr(flags,'-',nflags) != NULL);
+            return q + 1 - p;
+        case 'c':
+            segment->type = FORMAT_CHAR;
+            return q + 1 - p;
+        case 'd': case 'i': case 'u': case 'x': case 'X': case 'o':
+            size = "ll";
+            break;
+        case 'f': case 'F': case 'e': case 'E': case 'g': case 'G':
+            break;
+        default:
+            return 0;
+    }
+
+    segment->type = FORMAT_PRINTF;
+    *spec++ = '%';
+    memcpy(spec,flags,nflags);
+    spec += nflags;
+    if (width >= 0) { spec += sprintf(spec,"%d",width); }
+    if (precision >= 0) { spec += sprintf(spec,".%d",precision); }
+    spec += sprintf(spec,"%s%c",size,*q);
+    return q + 1 - p;
+}
+
+/*
+ * format_compile
+ *
+ * Compiles format. Called by intern.c the first time a format is
+ * interned
+ */
+
+void* format_compile (const char* format)
+{
+    int             length = strlen(format);
+    int             literals_len = 0;
+    int             nstrings = 0;
+    CompiledFormat* compiled;
+    const char*     p = format;
+
+    /* a format of n characters can't have more than n segments */
+
+    compiled = (CompiledFormat *) Tcl_Alloc(sizeof(CompiledFormat) + (length + 1) * sizeof(FormatSegment));
+    compiled->literals     = Tcl_Alloc(length + 1);
+    compiled->nsegments    = 0;
+    compiled->nconversions = 0;
+    compiled->plain        = true;
+
+    while (*p != '\0') {
+        if (*p == '%') {
+            FormatSegment*  segment = &compiled->segments[compiled->nsegments];
+            int             n;
+
+            if (p[1] == '%') {
+                format_append_literal(compiled,&literals_len,"%",1);
+                p += 2;
+                continue;
+            }
+            if ((n = format_parse_conversion(p,segment)) > 0) {
+                if (segment->type == FORMAT_STRING) {
+                    nstrings++;
+                } else {
+                    compiled->plain = false;
+                }
+                compiled->nsegments++;
+                compiled->nconversions++;
+                p += n;
+                continue;
+            }
+        }
+        format_append_literal(compiled,&literals_len,p,1);
+        p++;
+    }
+    if (nstrings > 1) {
+        compiled->plain = false;
+    }
+    return compiled;
+}
+
+void format_free (void* data)
+{
+    CompiledFormat* compiled = (CompiledFormat *) data;
+
+    Tcl_Free(compiled->literals);
+    Tcl_Free((char *) compiled);
+}
+
+/*
+ * format_compiled
+ *
+ * The compiled form of an interned format
+ */
+
+const CompiledFormat* format_compiled (const char* format)
+{
+    return (const CompiledFormat *) intern_data(format);
+}
+
+/*
+ * format_append
+ *
+ * Appends to out a conversion rendered by snprintf. Most of them fit
+ * the first attempt, a larger one is rendered again with the room
+ * it needs
+ */
+
+static void format_append (Tcl_DString* out,const char* spec,...)
+{
+    int     offset = Tcl_DStringLength(out);
+    int     room = 64;
+    int     n;
+    va_list ap;
+
+    Tcl_DStringSetLength(out,offset + room);
+    va_start(ap,spec);
+    n = vsnprintf(Tcl_DStringValue(out) + offset,room + 1,spec,ap);
+    va_end(ap);
+    if (n > room) {
+        Tcl_DStringSetLength(out,offset + n);
+        va_start(ap,spec);
+        vsnprintf(Tcl_DStringValue(out) + offset,n + 1,spec,ap);
+        va_end(ap);
+    }
+    Tcl_DStringSetLength(out,offset + ((n < 0) ? 0 : n));
+}
+
+/*
+ * format_append_padded
+ *
+ * Appends text cut to precision and padded with blanks to width,
+ * both counted in characters
+ */
+
+static void format_append_padded (Tcl_DString* out,const FormatSegment* segment,const char* text,int length)
+{
+    int nchars = Tcl_NumUtfChars(text,length);
+    int pad;
+
+    if ((segment->precision >= 0) && (segment->precision < nchars)) {
+        length = Tcl_UtfAtIndex(text,segment->precision) - text;
+        nchars = segment->precision;
+    }
+    pad = (segment->width > nchars) ? segment->width - nchars : 0;
+    if (!segment->left) {
+        for ( ; pad > 0; pad--) { Tcl_DStringAppend(out," ",1); }
+    }
+    Tcl_DStringAppend(out,text,length);
+    for ( ; pad > 0; pad--) { Tcl_DStringAppend(out," ",1); }
+}
+
+/*
+ * format_utf8
+ *
+ * Encodes a code point up to 0x10FFFF in UTF-8. Tcl_UniCharToUtf can't
+ * be used: with the 16 bit Tcl_UniChar of Tcl 8.6 the code points
+ * beyond 0xFFFF don't fit
+ *
+ * Returned value: the number of bytes written in utf
+ */
+
+static int format_utf8 (int code,char* utf)
+{
+    if (code < 0x80) {
+        utf[0] = (char) code;
+        return 1;
+    }
+    if (code < 0x800) {
+        utf[0] = (char) (0xC0 | (code >> 6));
+        utf[1] = (char) (0x80 | (code & 0x3F));
+        return 2;
+    }
+    if (code < 0x10000) {
+        utf[0] = (char) (0xE0 | (code >> 12));
+        utf[1] = (char) (0x80 | ((code >> 6) & 0x3F));
+        utf[2] = (char) (0x80 | (code & 0x3F));
+        return 3;
+    }
+    utf[0] = (char) (0xF0 | (code >> 18));
+    utf[1] = (char) (0x80 | ((code >> 12) & 0x3F));
+    utf[2] = (char) (0x80 | ((code >> 6) & 0x3F));
+    utf[3] = (char) (0x80 | (code & 0x3F));
+    return 4;
+}
+
+/*
+ * format_render
+ *
+ * Renders in out (replacing its content) the compiled format taking
+ * the values of the conversions from args
+ *
+ * Returned value: TCL_OK or TCL_ERROR (too few arguments or an argument
+ * not valid for its conversion), the message is left in interp when
+ * not NULL
+ */
+
+int format_render (Tcl_Interp* interp,const CompiledFormat* compiled,Tcl_DString* out,
+                   Tcl_Obj* const args[],int nargs)
+{
+    int arg = 0;
+    int i;
+
+    if (nargs < compiled->nconversions) {
+        if (interp != NULL) {
+            Tcl_SetObjResult(interp,Tcl_ObjPrintf("not enough arguments for the format (%d expected)",
+                                                  compiled->nconversions));
+        }
+        return TCL_ERROR;
+    }
+
+    Tcl_DStringSetLength(out,0);
+    for (i = 0; i < compiled->nsegments; i++) {
+        const FormatSegment* segment = &compiled->segments[i];
+
+        switch (segment->type) {
+            case FORMAT_LITERAL:
+                Tcl_DStringAppend(out,compiled->literals + segment->offset,segment->length);
+                break;
+            case FORMAT_STRING:
+            {
+                int         length;
+                const char* text = Tcl_GetStringFromObj(args[arg++],&length);
+
+                Tcl_DStringAppend(out,text,length);
+                break;
+            }
+            case FORMAT_PADDED:
+            {
+                int         length;
+                const char* text = Tcl_GetStringFromObj(args[arg++],&length);
+
+                format_append_padded(out,segment,text,length);
+                break;
+            }
+            case FORMAT_CHAR:
+            {
+                int     code;
+                char    utf[8];
+
+                if (Tcl_GetIntFromObj(interp,args[arg++],&code) != TCL_OK) {
+                    return TCL_ERROR;
+                }
+                if ((code < 0) || (code > 0x10FFFF)) {
+                    if (interp != NULL) {
+                        Tcl_SetObjResult(interp,Tcl_ObjPrintf("character code %d out of range",code));
+                    }
+                    return TCL_ERROR;
+                }
+                Tcl_DStringAppend(out,utf,format_utf8(code,utf));
+                break;
+            }
+            case FORMAT_PRINTF:
+            {
+                Tcl_Obj* value = args[arg++];
+
+                switch (segment->conversion) {
+                    case 'd': case 'i': case 'u': case 'x': case 'X': case 'o':
+                    {
+                        Tcl_WideInt integer;
+
+                        if (Tcl_GetWideIntFromObj(interp,value,&integer) != TCL_OK) {
+                            return TCL_ERROR;
+                        }
+                        if ((segment->conversion == 'd') || (segment->conversion == 'i')) {
+                            format_append(out,segment->spec,(long long) integer);
+                        } else {
+                            format_append(out,segment->spec,(unsigned long long) integer);
+                        }
+                        break;
+                    }
+                    default:
+                    {
+                        double real;
+
+                        if (Tcl_GetDoubleFromObj(interp,value,&real) != TCL_OK) {
+                            return TCL_ERROR;
+                        }
+                        format_append(out,segment->spec,real);
+                        break;
+                    }
+                }
+                break;
+            }
+        }
+    }
+    return TCL_OK;
+}
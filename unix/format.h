@@ -0,0 +1,64 @@
+/*
+ *    format.h - compiled -format strings
+ *
+ *    A Tcl interface to the POSIX syslog service.
+ *
+ *    Copyright (C) 2026 Massimo Manghi <mxmanghi@apache.org>
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __format_h__
+#define __format_h__
+
+#include "syslog.h"
+
+/* segment types */
+
+#define FORMAT_LITERAL      0   /* text copied as it is */
+#define FORMAT_STRING       1   /* %s with no flags, width or precision */
+#define FORMAT_PRINTF       2   /* conversion rendered with snprintf and spec */
+#define FORMAT_CHAR         3   /* %c, the argument is a code point */
+#define FORMAT_PADDED       4   /* %s with flags, width or precision */
+
+/* upper bound of width and precision in a conversion */
+
+#define FORMAT_MAX_WIDTH    512
+
+typedef struct FormatSegment {
+    int     type;
+    int     offset;         /* FORMAT_LITERAL: text in the literals buffer */
+    int     length;
+    char    conversion;     /* FORMAT_PRINTF: the conversion character */
+    char    spec[24];       /* FORMAT_PRINTF: the snprintf format */
+    int     width;          /* FORMAT_PADDED: characters, -1 when missing */
+    int     precision;
+    bool    left;           /* FORMAT_PADDED: the '-' flag */
+} FormatSegment;
+
+typedef struct CompiledFormat {
+    int             nconversions;
+    bool            plain;      /* only literals and at most one FORMAT_STRING */
+    int             nsegments;
+    char*           literals;   /* the literal text of all segments */
+    FormatSegment   segments[];
+} CompiledFormat;
+
+void*                   format_compile (const char* format);
+const CompiledFormat*   format_compiled (const char* format);
+int                     format_render (Tcl_Interp* interp,const CompiledFormat* compiled,Tcl_DString* out,
+                                       Tcl_Obj* const args[],int nargs);
+void                    format_free (void* compiled);
+
+#endif /* __format_h__ */
@@ -25,6 +25,10 @@
 SyslogGlobalStatus *g_status = NULL;
 char* g_default_format = "%s";
 
+/* -escape modes, indexed by the ESCAPE_* codes */
+
+const char* escape_modes[] = { "none", "octal", "json", NULL };
+
 /*
  * parse_open_options
  *
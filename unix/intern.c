@@ -0,0 +1,255 @@
+/*
+ *    intern.c - process-wide table of shared strings
+ *
+ *    A Tcl interface to the POSIX syslog service.
+ *
+ *    Copyright (C) 2026 Massimo Manghi <mxmanghi@apache.org>
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Formats and idents are interned: every distinct string is stored once
+ * in a hash table shared by all threads and reference counted. Threads
+ * setting the same -format share a copy and setting again a format
+ * already in use is a hash lookup with no memory allocation.
+ *
+ * The strings returned by intern_acquire are immutable and stay valid
+ * until the matching intern_release. A format interned by
+ * intern_acquire_format also carries its compiled form (format.c),
+ * built once when the format enters the table.
+ *
+ * A format released by its last user isn't freed right away: the last
+ * INTERN_MAX_UNUSED of them are kept (least recently released first to
+ * go) so that a thread switching back and forth between formats
+ * doesn't compile them every time. Every string has a serial number
+ * never reused, the bodies cached by msgcache.c are bound to it and a
+ * format freed and another one interned at the same address can't be
+ * mistaken for each other
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stddef.h>
+#include <string.h>
+
+#include "syslog.h"
+#include "format.h"
+
+#define INTERN_MAX_UNUSED   16
+
+typedef struct InternString {
+    Tcl_HashEntry*          entry;
+    int                     refcount;
+    unsigned int            serial;
+    void*                   data;       /* compiled format, NULL for an ident */
+    struct InternString*    prev;       /* list of the formats no longer used */
+    struct InternString*    next;
+    char                    text[];
+} InternString;
+
+static Tcl_HashTable    intern_table;
+static bool             intern_initialized = false;
+static Tcl_Mutex        intern_lock;
+static unsigned int     intern_serial_counter = 0;
+static InternString*    unused_head = NULL;         /* least recently released */
+static InternString*    unused_tail = NULL;
+static int              unused_count = 0;
+
+#define INTERN_STRING(text) ((InternString *) ((char *) (text) - offsetof(InternString,text)))
+
+/*
+ * intern_unused_remove
+ *
+ * Takes string off the list of the formats no longer used, called with
+ * intern_lock held
+ */
+
+static void intern_unused_remove (InternString* string)
+{
+    if (string->prev != NULL) { string->prev->next = string->next; } else { unused_head = string->next; }
+    if (string->next != NULL) { string->next->prev = string->prev; } else { unused_tail = string->prev; }
+    string->prev = string->next = NULL;
+    unused_count--;
+}
+
+/*
+ * intern_free
+ *
+ * Removes string from the table and frees it, called with intern_lock
+ * held
+ */
+
+static void intern_free (InternString* string)
+{
+    Tcl_DeleteHashEntry(string->entry);
+    if (string->data != NULL) {
+        format_free(string->data);
+    }
+    Tcl_Free((char *) string);
+}
+
+/*
+ * intern_acquire_string
+ *
+ * Returns the interned copy of text incrementing its reference count.
+ * With compile set the string is a format which is compiled when not
+ * done yet
+ */
+
+static const char* intern_acquire_string (const char* text,bool compile)
+{
+    Tcl_HashEntry*  entry;
+    InternString*   string;
+    int             is_new;
+
+    Tcl_MutexLock(&intern_lock);
+    if (!intern_initialized) {
+        Tcl_InitHashTable(&intern_table,TCL_STRING_KEYS);
+        intern_initialized = true;
+    }
+
+    entry = Tcl_CreateHashEntry(&intern_table,text,&is_new);
+    if (is_new) {
+        size_t length = strlen(text);
+
+        string = (InternString *) Tcl_Alloc(sizeof(InternString) + length + 1);
+        string->entry    = entry;
+        string->refcount = 0;
+        string->serial   = ++intern_serial_counter;
+        string->data     = NULL;
+        string->prev     = NULL;
+        string->next     = NULL;
+        memcpy(string->text,text,length + 1);
+        Tcl_SetHashValue(entry,string);
+    } else {
+        string = (InternString *) Tcl_GetHashValue(entry);
+        if (string->refcount == 0) {
+            intern_unused_remove(string);
+        }
+    }
+    if (compile && (string->data == NULL)) {
+        string->data = format_compile(string->text);
+    }
+    string->refcount++;
+    Tcl_MutexUnlock(&intern_lock);
+
+    return string->text;
+}
+
+/*
+ * intern_fork_prepare, intern_fork_release
+ *
+ * The table lock is held across fork so that the child never finds
+ * the table in the middle of an update
+ */
+
+void intern_fork_prepare (void)
+{
+    Tcl_MutexLock(&intern_lock);
+}
+
+void intern_fork_release (void)
+{
+    Tcl_MutexUnlock(&intern_lock);
+}
+
+const char* intern_acquire (const char* text)
+{
+    return intern_acquire_string(text,false);
+}
+
+const char* intern_acquire_format (const char* text)
+{
+    return intern_acquire_string(text,true);
+}
+
+/*
+ * intern_data
+ *
+ * The compiled form of a format returned by intern_acquire_format.
+ * It's immutable and shares the lifetime of the interned string
+ */
+
+void* intern_data (const char* text)
+{
+    return INTERN_STRING(text)->data;
+}
+
+/*
+ * intern_serial
+ *
+ * The serial number of a string returned by intern_acquire, no other
+ * string ever gets the same number
+ */
+
+unsigned int intern_serial (const char* text)
+{
+    return INTERN_STRING(text)->serial;
+}
+
+/*
+ * intern_release
+ *
+ * Releases a string returned by intern_acquire. The last release of an
+ * ident removes it from the table, a format is appended to the list of
+ * the formats no longer used and the least recently released one is
+ * freed when the list is longer than INTERN_MAX_UNUSED. NULL is ignored
+ */
+
+void intern_release (const char* text)
+{
+    InternString* string;
+
+    if (text == NULL) { return; }
+
+    string = INTERN_STRING(text);
+    Tcl_MutexLock(&intern_lock);
+    if (--string->refcount == 0) {
+        if (string->data == NULL) {
+            intern_free(string);
+        } else {
+            string->prev = unused_tail;
+            string->next = NULL;
+            if (unused_tail != NULL) { unused_tail->next = string; } else { unused_head = string; }
+            unused_tail = string;
+            if (++unused_count > INTERN_MAX_UNUSED) {
+                InternString* oldest = unused_head;
+
+                intern_unused_remove(oldest);
+                intern_free(oldest);
+            }
+        }
+    }
+    Tcl_MutexUnlock(&intern_lock);
+}
+
+/*
+ * intern_count
+ *
+ * Number of distinct strings in use, the formats kept after their last
+ * release are not counted
+ */
+
+int intern_count (void)
+{
+    int count;
+
+    Tcl_MutexLock(&intern_lock);
+    count = intern_initialized ? intern_table.numEntries - unused_count : 0;
+    Tcl_MutexUnlock(&intern_lock);
+    return count;
+}
@@ -0,0 +1,269 @@
+/*
+ *    json.c - JSON/CEE encoding of structured log messages
+ *
+ *    A Tcl interface to the POSIX syslog service.
+ *
+ *    Copyright (C) 2026 Massimo Manghi <mxmanghi@apache.org>
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+#include "syslog.h"
+
+#define CEE_COOKIE  "@cee: "
+
+static const char hex_digits[] = "0123456789abcdef";
+
+/*
+ * json_is_number
+ *
+ * Checks whether text is a number in the JSON grammar
+ *
+ *      -?(0|[1-9][0-9]*)(\.[0-9]+)?([eE][+-]?[0-9]+)?
+ *
+ * Anything else (leading zeros, hexadecimal, octal, 'Inf'...) is
+ * encoded as a string
+ */
+
+static bool json_is_number (const char* text,int length)
+{
+    const char* p = text;
+    const char* end = text + length;
+
+    if ((p < end) && (*p == '-')) { p++; }
+    if (p == end) { return false; }
+
+    if (*p == '0') {
+        p++;
+    } else if ((*p >= '1') && (*p <= '9')) {
+        while ((p < end) && (*p >= '0') && (*p <= '9')) { p++; }
+    } else {
+        return false;
+    }
+
+    if ((p < end) && (*p == '.')) {
+        const char* digits = ++p;
+        while ((p < end) && (*p >= '0') && (*p <= '9')) { p++; }
+        if (p == digits) { return false; }
+    }
+
+    if ((p < end) && ((*p == 'e') || (*p == 'E'))) {
+        const char* digits;
+        p++;
+        if ((p < end) && ((*p == '+') || (*p == '-'))) { p++; }
+        digits = p;
+        while ((p < end) && (*p >= '0') && (*p <= '9')) { p++; }
+        if (p == digits) { return false; }
+    }
+    return (p == end);
+}
+
+/*
+ * json_append_string
+ *
+ * Appends text as a quoted JSON string. Runs of characters needing no
+ * escape are copied with a single append. The Tcl internal encoding of
+ * U+0000 (0xC0 0x80) is written as \u0000
+ */
+
+static void json_append_string (Tcl_DString* out,const char* text,int length)
+{
+    const unsigned char* p     = (const unsigned char *) text;
+    const unsigned char* end   = p + length;
+    const unsigned char* run   = p;
+    char                 escape[7];
+
+    Tcl_DStringAppend(out,"\"",1);
+    while (p < end) {
+        unsigned char c = *p;
+        const char*   replacement = NULL;
+        int           replacement_len = 2;
+        int           consumed = 1;
+
+        if ((c >= 0x20) && (c != '"') && (c != '\\') && (c != 0xC0)) {
+            p++;
+            continue;
+        }
+
+        switch (c) {
+            case '"':  replacement = "\\\""; break;
+            case '\\': replacement = "\\\\"; break;
+            case '\n': replacement = "\\n";  break;
+            case '\r': replacement = "\\r";  break;
+            case '\t': replacement = "\\t";  break;
+            case '\b': replacement = "\\b";  break;
+            case '\f': replacement = "\\f";  break;
+            case 0xC0:
+                if ((p + 1 < end) && (p[1] == 0x80)) {
+                    replacement = "\\u0000";
+                    replacement_len = 6;
+                    consumed = 2;
+                } else {
+                    p++;
+                    continue;
+                }
+                break;
+            default:
+                memcpy(escape,"\\u00",4);
+                escape[4] = hex_digits[c >> 4];
+                escape[5] = hex_digits[c & 0x0f];
+                replacement = escape;
+                replacement_len = 6;
+                break;
+        }
+
+        Tcl_DStringAppend(out,(const char *) run,p - run);
+        Tcl_DStringAppend(out,replacement,replacement_len);
+        p  += consumed;
+        run = p;
+    }
+    Tcl_DStringAppend(out,(const char *) run,p - run);
+    Tcl_DStringAppend(out,"\"",1);
+}
+
+/*
+ * json_key_overridden
+ *
+ * Whether key is also a key of one of the dictionaries in layers (or is
+ * 'msg' and the object has a message): the later value wins and this
+ * one is not written
+ */
+
+static bool json_key_overridden (Tcl_Obj* key,Tcl_Obj** layers,int nlayers,bool has_message)
+{
+    int i;
+
+    if (has_message && (strcmp(Tcl_GetString(key),"msg") == 0)) { return true; }
+    for (i = 0; i < nlayers; i++) {
+        Tcl_Obj* value = NULL;
+
+        if ((Tcl_DictObjGet(NULL,layers[i],key,&value) == TCL_OK) && (value != NULL)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/*
+ * json_append_pairs
+ *
+ * Appends the key-value pairs of dictionary as members of a JSON object,
+ * except those whose key is overridden by the dictionaries in layers.
+ * Values that are numbers according to the JSON grammar are written as
+ * such, everything else as strings
+ */
+
+static int json_append_pairs (Tcl_Interp* interp,Tcl_DString* out,Tcl_Obj* dictionary,
+                              Tcl_Obj** layers,int nlayers,bool has_message,bool* first)
+{
+    Tcl_DictSearch  search;
+    Tcl_Obj*        key;
+    Tcl_Obj*        value;
+    int             done;
+
+    if (Tcl_DictObjFirst(interp,dictionary,&search,&key,&value,&done) != TCL_OK) {
+        return TCL_ERROR;
+    }
+
+    for (; !done; Tcl_DictObjNext(&search,&key,&value,&done)) {
+        int         key_len,value_len;
+        const char* key_s;
+        const char* value_s;
+
+        if (json_key_overridden(key,layers,nlayers,has_message)) { continue; }
+
+        key_s   = Tcl_GetStringFromObj(key,&key_len);
+        value_s = Tcl_GetStringFromObj(value,&value_len);
+        if (!*first) { Tcl_DStringAppend(out,",",1); }
+        *first = false;
+
+        json_append_string(out,key_s,key_len);
+        Tcl_DStringAppend(out,":",1);
+        if (json_is_number(value_s,value_len)) {
+            Tcl_DStringAppend(out,value_s,value_len);
+        } else {
+            json_append_string(out,value_s,value_len);
+        }
+    }
+    Tcl_DictObjDone(&search);
+    return TCL_OK;
+}
+
+/*
+ * json_encode
+ *
+ * Encodes as a JSON object in out (replacing its content) the pairs of
+ * the dictionaries in the context list (may be NULL) and those of
+ * dictionary. Every key is written once: a key of the context is
+ * overridden by the same key in a dictionary pushed later or in
+ * dictionary. When message is not NULL it's added to the object with the
+ * key 'msg', overriding a 'msg' key of the dictionaries. With cee set the
+ * object is prefixed with the '@cee: ' cookie expected by rsyslog's
+ * mmjsonparse
+ *
+ * Returned value: TCL_OK or TCL_ERROR if dictionary (or an element of
+ * context) is not a valid dict
+ */
+
+int json_encode (Tcl_Interp* interp,Tcl_DString* out,Tcl_Obj* context,Tcl_Obj* dictionary,
+                 const char* message,int message_len,bool cee)
+{
+    Tcl_Obj*    layers_static[8];
+    Tcl_Obj**   layers = layers_static;
+    Tcl_Obj**   elements = NULL;
+    bool        has_message = (message != NULL);
+    bool        first = true;
+    int         ncontext = 0;
+    int         result = TCL_OK;
+    int         i;
+
+    Tcl_DStringSetLength(out,0);
+    if (cee) {
+        Tcl_DStringAppend(out,CEE_COOKIE,-1);
+    }
+    Tcl_DStringAppend(out,"{",1);
+
+    /* the context dictionaries and then dictionary, in order of precedence */
+
+    if ((context != NULL) && (Tcl_ListObjGetElements(interp,context,&ncontext,&elements) != TCL_OK)) {
+        return TCL_ERROR;
+    }
+    if (ncontext + 1 > (int) (sizeof(layers_static)/sizeof(Tcl_Obj*))) {
+        layers = (Tcl_Obj **) Tcl_Alloc((ncontext + 1) * sizeof(Tcl_Obj*));
+    }
+    for (i = 0; i < ncontext; i++) {
+        layers[i] = elements[i];
+    }
+    layers[ncontext] = dictionary;
+
+    for (i = 0; (i <= ncontext) && (result == TCL_OK); i++) {
+        result = json_append_pairs(interp,out,layers[i],layers + i + 1,ncontext - i,has_message,&first);
+    }
+    if (layers != layers_static) {
+        Tcl_Free((char *) layers);
+    }
+    if (result != TCL_OK) {
+        return TCL_ERROR;
+    }
+
+    if (has_message) {
+        if (!first) { Tcl_DStringAppend(out,",",1); }
+        json_append_string(out,"msg",3);
+        Tcl_DStringAppend(out,":",1);
+        json_append_string(out,message,message_len);
+    }
+    Tcl_DStringAppend(out,"}",1);
+    return TCL_OK;
+}
@@ -0,0 +1,209 @@
+/*
+ *    msgcache.c - record bodies cached in the message Tcl_Obj
+ *
+ *    A Tcl interface to the POSIX syslog service.
+ *
+ *    Copyright (C) 2026 Massimo Manghi <mxmanghi@apache.org>
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Constant messages ("cache miss", "connection accepted") are literals the
+ * Tcl compiler shares among all the calls logging them. The record body
+ * built from a message (context prefix, -format expansion and -escape)
+ * is stored in the internal representation of the message object, the
+ * next call logging the same object sends it with no rendering at all.
+ *
+ * A cached body is valid as long as
+ *
+ *  - the configuration generation didn't change. The generation is
+ *    bumped by ::syslog::configure and by reopening the connection
+ *  - the thread generation didn't change. It's drawn from the same
+ *    counter when the thread context changes, so that a body is never
+ *    sent by another thread or with a stale context
+ *  - the thread format and escape mode are the ones it was built with.
+ *    The format is compared with its intern serial too: a format freed
+ *    and another one interned at the same address don't match
+ *
+ * Tcl objects are owned by a thread, no locking is needed to access the
+ * cache. Only objects with no internal representation (or a cached body)
+ * are converted: a message that is also a number or a list keeps its
+ * representation. Objects not shared are temporary values and messages
+ * longer than MSGCACHE_MAX_LENGTH are not worth the copy, they are never
+ * cached.
+ *
+ * A shared string is not necessarily a constant: a message built once
+ * and stored in a variable is shared as well. The first time an object
+ * is logged it's only marked (the type is set with no body), the body
+ * is copied the second time the same object is logged
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <string.h>
+
+#include "syslog.h"
+
+extern char* g_default_format;
+
+typedef struct MessageCache {
+    unsigned int    config_generation;
+    unsigned int    thread_generation;
+    const char*     format;
+    unsigned int    format_serial;
+    int             escape;
+    int             length;
+    char            body[];
+} MessageCache;
+
+static unsigned int next_generation   = 1;
+static unsigned int config_generation = 1;
+
+#define FORMAT_SERIAL(format) (((format) == g_default_format) ? 0 : intern_serial(format))
+
+static void msgcache_free_internal (Tcl_Obj* obj);
+static void msgcache_dup_internal (Tcl_Obj* src,Tcl_Obj* dup);
+
+static const Tcl_ObjType msgcache_type = {
+    "syslog-message",
+    msgcache_free_internal,
+    msgcache_dup_internal,
+    NULL,
+    NULL
+};
+
+/* NULL when the object was logged only once */
+
+#define MESSAGE_CACHE(obj) ((MessageCache *)(obj)->internalRep.twoPtrValue.ptr1)
+
+static void msgcache_free_internal (Tcl_Obj* obj)
+{
+    if (MESSAGE_CACHE(obj) != NULL) {
+        Tcl_Free((char *) MESSAGE_CACHE(obj));
+    }
+    obj->typePtr = NULL;
+}
+
+static void msgcache_dup_internal (Tcl_Obj* src,Tcl_Obj* dup)
+{
+    MessageCache* cache = NULL;
+
+    if (MESSAGE_CACHE(src) != NULL) {
+        size_t size = sizeof(MessageCache) + MESSAGE_CACHE(src)->length;
+
+        cache = (MessageCache *) Tcl_Alloc(size);
+        memcpy(cache,MESSAGE_CACHE(src),size);
+    }
+    dup->internalRep.twoPtrValue.ptr1 = cache;
+    dup->internalRep.twoPtrValue.ptr2 = NULL;
+    dup->typePtr = &msgcache_type;
+}
+
+/*
+ * msgcache_invalidate
+ *
+ * Starts a new configuration generation: every cached body is built
+ * again the next time its message is logged
+ */
+
+void msgcache_invalidate (void)
+{
+    SYSLOG_ATOMIC_STORE(config_generation,SYSLOG_ATOMIC_INCR(next_generation));
+}
+
+/*
+ * msgcache_thread_generation
+ *
+ * A new generation for the bodies cached by a thread, called when
+ * the thread context changes
+ */
+
+unsigned int msgcache_thread_generation (void)
+{
+    return SYSLOG_ATOMIC_INCR(next_generation);
+}
+
+/*
+ * msgcache_lookup
+ *
+ * Returned value: true when obj carries a body valid for the thread
+ * status, which is stored in body
+ */
+
+bool msgcache_lookup (SyslogThreadStatus* status,Tcl_Obj* obj,struct iovec* body)
+{
+    MessageCache* cache;
+
+    if (obj->typePtr != &msgcache_type) { return false; }
+
+    cache = MESSAGE_CACHE(obj);
+    if ((cache == NULL) || (cache->config_generation != SYSLOG_ATOMIC_LOAD(config_generation)) ||
+        (cache->thread_generation != status->generation) ||
+        (cache->format != status->format) || (cache->escape != status->escape) ||
+        (cache->format_serial != FORMAT_SERIAL(status->format))) {
+        return false;
+    }
+    body->iov_base = cache->body;
+    body->iov_len  = cache->length;
+    return true;
+}
+
+/*
+ * msgcache_store
+ *
+ * Caches in obj the record body made of the nbody segments in body.
+ * An object logged for the first time is only marked
+ */
+
+void msgcache_store (SyslogThreadStatus* status,Tcl_Obj* obj,const struct iovec* body,int nbody)
+{
+    MessageCache*   cache;
+    int             length = 0;
+    int             i;
+
+    if (((obj->typePtr != NULL) && (obj->typePtr != &msgcache_type)) ||
+        (obj->bytes == NULL) || !Tcl_IsShared(obj)) {
+        return;
+    }
+    for (i = 0; i < nbody; i++) {
+        length += body[i].iov_len;
+    }
+    if (length > MSGCACHE_MAX_LENGTH) { return; }
+
+    if (obj->typePtr == NULL) {
+        obj->internalRep.twoPtrValue.ptr1 = NULL;
+        obj->internalRep.twoPtrValue.ptr2 = NULL;
+        obj->typePtr = &msgcache_type;
+        return;
+    }
+    msgcache_free_internal(obj);
+    cache = (MessageCache *) Tcl_Alloc(sizeof(MessageCache) + length);
+    cache->config_generation = SYSLOG_ATOMIC_LOAD(config_generation);
+    cache->thread_generation = status->generation;
+    cache->format            = status->format;
+    cache->format_serial     = FORMAT_SERIAL(status->format);
+    cache->escape            = status->escape;
+    cache->length            = 0;
+    for (i = 0; i < nbody; i++) {
+        memcpy(cache->body + cache->length,body[i].iov_base,body[i].iov_len);
+        cache->length += body[i].iov_len;
+    }
+
+    obj->internalRep.twoPtrValue.ptr1 = cache;
+    obj->internalRep.twoPtrValue.ptr2 = NULL;
+    obj->typePtr = &msgcache_type;
+}
@@ -69,16 +69,35 @@
 
 #define NOOPT -1
 
+/* not a syslog(3) option, the flag is handled by the transport */
+
+#define SYSLOG_NONBLOCKING  0x1000
+
 #define SYSLOG_OPTIONS(X) \
     X("-pid",LOG_PID,log_pid_idx,GLOBAL_OPTION_CLASS) \
     X("-perror",LOG_PERROR,log_perror_idx,GLOBAL_OPTION_CLASS) \
     X("-console",LOG_CONS,log_console_idx,GLOBAL_OPTION_CLASS) \
     X("-nodelay",LOG_NDELAY,log_ndelay_idx,GLOBAL_OPTION_CLASS) \
+    X("-nonblocking",SYSLOG_NONBLOCKING,nonblocking_idx,RUNTIME_OPTION_CLASS) \
     X("-ident",NOOPT,ident_idx,GLOBAL_OPTION_CLASS) \
+    X("-socket",NOOPT,socket_idx,GLOBAL_OPTION_CLASS) \
+    X("-maxsize",NOOPT,maxsize_idx,GLOBAL_OPTION_CLASS) \
+    X("-connections",NOOPT,connections_idx,GLOBAL_OPTION_CLASS) \
+    X("-queue",NOOPT,queue_idx,GLOBAL_OPTION_CLASS) \
+    X("-sndbuf",NOOPT,sndbuf_idx,GLOBAL_OPTION_CLASS) \
+    X("-ring",NOOPT,ring_idx,GLOBAL_OPTION_CLASS) \
+    X("-ringslots",NOOPT,ringslots_idx,GLOBAL_OPTION_CLASS) \
+    X("-sendtimeout",NOOPT,sendtimeout_idx,RUNTIME_OPTION_CLASS) \
+    X("-threshold",NOOPT,threshold_idx,RUNTIME_OPTION_CLASS) \
+    X("-levelsignal",NOOPT,levelsignal_idx,RUNTIME_OPTION_CLASS) \
+    X("-levelfile",NOOPT,levelfile_idx,RUNTIME_OPTION_CLASS) \
     X("-facility",NOOPT,facility_idx,UNDEFINED_OPTION_CLASS) \
     X("-priority",NOOPT,priority_idx,PER_THREAD_OPTION_CLASS) \
     X("-level",NOOPT,level_idx,PER_THREAD_OPTION_CLASS) \
-    X("-format",NOOPT,format_idx,PER_THREAD_OPTION_CLASS)
+    X("-format",NOOPT,format_idx,PER_THREAD_OPTION_CLASS) \
+    X("-escape",NOOPT,escape_idx,PER_THREAD_OPTION_CLASS) \
+    X("-json",NOOPT,json_idx,PER_CALL_OPTION_CLASS) \
+    X("-cee",NOOPT,cee_idx,PER_CALL_OPTION_CLASS)
 
 /* these enums just provide a way to count how many
  * elements for each parameter exist
@@ -22,12 +22,16 @@
 #include <syslog.h>
 #include "syslog.h"
 #include "params.h"
+#include "transport.h"
+#include "queue.h"
+#include "ring.h"
 
 extern SyslogGlobalStatus *g_status;
 extern char* g_default_format;
 extern int opt_class[];
 extern int opt_code[];
 extern const char* options[];
+extern const char* escape_modes[];
 
 static void missing_option_value (Tcl_Interp* interp,char* cmd,Tcl_Obj* option)
 {
@@ -56,24 +60,13 @@ static void missing_option_value (Tcl_Interp* interp,char* cmd,Tcl_Obj* option)
     Tcl_DecrRefCount(error_code_list);
 }
 
-/*
- * parse_options
- *
- */
-
-int parse_options (Tcl_Interp *interp, int objc, Tcl_Obj *CONST86 objv[],ParseArgsOptions* pao)
+static int parse_arguments (Tcl_Interp *interp, int objc, Tcl_Obj *CONST86 objv[],ParseArgsOptions* pao)
 {
     int     index    = 1;
     int     fchanged = 0;
     int     option_idx;
     char*   tcl_command = Tcl_GetString(objv[0]);
 
-    pao->status->facility = -1;
-    if (pao->status->format != g_default_format) {
-        Tcl_Free(pao->status->format);
-        pao->status->format = (char *) g_default_format;
-    }
-
     while (index < objc) {
 
         /* Read the docs! Tcl_GetIndexFromObj stores an 
@@ -118,43 +111,277 @@ int parse_options (Tcl_Interp *interp, int objc, Tcl_Obj *CONST86 objv[],ParseAr
                     missing_option_value(interp,tcl_command,objv[index]);
                     return ERROR;
                 }
-                const char* ident = Tcl_GetString(objv[++index]);
-                size_t len = strlen(ident);
-                char *copy = (char *) Tcl_Alloc(len + 1);
-                memcpy(copy,ident,len + 1);
+                const char* ident = intern_acquire(Tcl_GetString(objv[++index]));
+
+                intern_release(g_status->ident);
+                g_status->ident = ident;
+                fchanged++;
+                pao->last_option_index = index;
+                break;
+            }
+            case socket_idx:
+            {
+                if (index == objc-1) {
+                    missing_option_value(interp,tcl_command,objv[index]);
+                    return ERROR;
+                }
+                const char* path = Tcl_GetString(objv[++index]);
+                size_t len = strlen(path);
+
+                if (g_status->socket_path != NULL) {
+                    Tcl_Free(g_status->socket_path);
+                    g_status->socket_path = NULL;
+                }
+
+                /* an empty path restores the system default */
+
+                if (len > 0) {
+                    char *copy = (char *) Tcl_Alloc(len + 1);
+                    memcpy(copy,path,len + 1);
+                    g_status->socket_path = copy;
+                }
+                fchanged++;
+                pao->last_option_index = index;
+                break;
+            }
+            case maxsize_idx:
+            {
+                int max_size;
+
+                if (index == objc-1) {
+                    missing_option_value(interp,tcl_command,objv[index]);
+                    return ERROR;
+                }
+                if (Tcl_GetIntFromObj(interp,objv[++index],&max_size) != TCL_OK) {
+                    return ERROR;
+                }
+
+                /* 0 disables the splitting of long messages */
+
+                if ((max_size != 0) && (max_size < MIN_MAX_SIZE)) {
+                    Tcl_Obj* error_message = Tcl_ObjPrintf("Invalid -maxsize value %d (must be 0 or at least %d)",
+                                                           max_size,MIN_MAX_SIZE);
+                    Tcl_SetObjResult(interp,error_message);
+                    return ERROR;
+                }
+                SYSLOG_ATOMIC_STORE(g_status->max_size,max_size);
+                fchanged++;
+                pao->last_option_index = index;
+                break;
+            }
+            case connections_idx:
+            {
+                int connections;
+
+                if (index == objc-1) {
+                    missing_option_value(interp,tcl_command,objv[index]);
+                    return ERROR;
+                }
+                if (Tcl_GetIntFromObj(interp,objv[++index],&connections) != TCL_OK) {
+                    return ERROR;
+                }
+                if ((connections < 1) || (connections > TRANSPORT_MAX_CONNECTIONS)) {
+                    Tcl_SetObjResult(interp,Tcl_ObjPrintf("Invalid -connections value %d (must be between 1 and %d)",
+                                                          connections,TRANSPORT_MAX_CONNECTIONS));
+                    return ERROR;
+                }
+                g_status->connections = connections;
+                fchanged++;
+                pao->last_option_index = index;
+                break;
+            }
+            case queue_idx:
+            {
+                int queue_size;
+
+                if (index == objc-1) {
+                    missing_option_value(interp,tcl_command,objv[index]);
+                    return ERROR;
+                }
+                if (Tcl_GetIntFromObj(interp,objv[++index],&queue_size) != TCL_OK) {
+                    return ERROR;
+                }
+                if ((queue_size < 0) || (queue_size > QUEUE_MAX_SIZE)) {
+                    Tcl_SetObjResult(interp,Tcl_ObjPrintf("Invalid -queue value %d (must be between 0 and %d)",
+                                                          queue_size,QUEUE_MAX_SIZE));
+                    return ERROR;
+                }
+                SYSLOG_ATOMIC_STORE(g_status->queue_size,queue_size);
+                fchanged++;
+                pao->last_option_index = index;
+                break;
+            }
+            case sndbuf_idx:
+            {
+                int sndbuf;
+
+                if (index == objc-1) {
+                    missing_option_value(interp,tcl_command,objv[index]);
+                    return ERROR;
+                }
+                if (Tcl_GetIntFromObj(interp,objv[++index],&sndbuf) != TCL_OK) {
+                    return ERROR;
+                }
+
+                /* 0 leaves the system default */
+
+                if (sndbuf < 0) {
+                    Tcl_SetObjResult(interp,Tcl_ObjPrintf("Invalid -sndbuf value %d",sndbuf));
+                    return ERROR;
+                }
+                g_status->sndbuf = sndbuf;
+                fchanged++;
+                pao->last_option_index = index;
+                break;
+            }
+            case ring_idx:
+            {
+                if (index == objc-1) {
+                    missing_option_value(interp,tcl_command,objv[index]);
+                    return ERROR;
+                }
+                const char* name = Tcl_GetString(objv[++index]);
+                size_t len = strlen(name);
+
+                if (g_status->ring_name != NULL) {
+                    Tcl_Free(g_status->ring_name);
+                    g_status->ring_name = NULL;
+                }
+
+                /* an empty name detaches from the ring */
+
+                if (len > 0) {
+                    g_status->ring_name = (char *) Tcl_Alloc(len + 1);
+                    memcpy(g_status->ring_name,name,len + 1);
+                }
+                fchanged++;
+                pao->last_option_index = index;
+                break;
+            }
+            case ringslots_idx:
+            {
+                int ring_slots;
+
+                if (index == objc-1) {
+                    missing_option_value(interp,tcl_command,objv[index]);
+                    return ERROR;
+                }
+                if (Tcl_GetIntFromObj(interp,objv[++index],&ring_slots) != TCL_OK) {
+                    return ERROR;
+                }
+                if ((ring_slots < RING_MIN_SLOTS) || (ring_slots > RING_MAX_SLOTS)) {
+                    Tcl_SetObjResult(interp,Tcl_ObjPrintf("Invalid -ringslots value %d (must be between %d and %d)",
+                                                          ring_slots,RING_MIN_SLOTS,RING_MAX_SLOTS));
+                    return ERROR;
+                }
+                g_status->ring_slots = ring_slots;
+                fchanged++;
+                pao->last_option_index = index;
+                break;
+            }
+            case sendtimeout_idx:
+            {
+                int send_timeout;
 
-                if (g_status->ident != NULL) {
-                    Tcl_Free(g_status->ident);
+                if (index == objc-1) {
+                    missing_option_value(interp,tcl_command,objv[index]);
+                    return ERROR;
+                }
+                if (Tcl_GetIntFromObj(interp,objv[++index],&send_timeout) != TCL_OK) {
+                    return ERROR;
+                }
+                if ((send_timeout < 0) || (send_timeout > TRANSPORT_MAX_SEND_TIMEOUT)) {
+                    Tcl_SetObjResult(interp,Tcl_ObjPrintf("Invalid -sendtimeout value %d (must be between 0 and %d)",
+                                                          send_timeout,TRANSPORT_MAX_SEND_TIMEOUT));
+                    return ERROR;
+                }
+                SYSLOG_ATOMIC_STORE(g_status->send_timeout,send_timeout);
+                fchanged++;
+                pao->last_option_index = index;
+                break;
+            }
+            case threshold_idx:
+            {
+                if (index == objc-1) {
+                    missing_option_value(interp,tcl_command,objv[index]);
+                    return ERROR;
+                }
+                int level = level_cli_to_code(interp,Tcl_GetString(objv[++index]));
+                if (level == ERROR) {
+                    return ERROR;
+                }
+                threshold_set(level);
+                fchanged++;
+                pao->last_option_index = index;
+                break;
+            }
+            case levelsignal_idx:
+            {
+                if (index == objc-1) {
+                    missing_option_value(interp,tcl_command,objv[index]);
+                    return ERROR;
+                }
+                if (threshold_set_signal(interp,objv[++index]) != TCL_OK) {
+                    return ERROR;
+                }
+                fchanged++;
+                pao->last_option_index = index;
+                break;
+            }
+            case levelfile_idx:
+            {
+                if (index == objc-1) {
+                    missing_option_value(interp,tcl_command,objv[index]);
+                    return ERROR;
                 }
-                g_status->ident = copy;
+                threshold_set_file(Tcl_GetString(objv[++index]));
                 fchanged++;
                 pao->last_option_index = index;
                 break;
             }
             case log_ndelay_idx:
             {
-                g_status->options = g_status->options | LOG_NDELAY;
+                SYSLOG_ATOMIC_STORE(g_status->options,g_status->options | LOG_NDELAY);
+                fchanged++;
+                pao->last_option_index = index;
+                break;
+            }
+            case nonblocking_idx:
+            {
+                int nonblocking = 1;
+
+                /* an optional boolean value, -nonblocking 0 clears the option */
+
+                if ((index < objc-1) &&
+                    (Tcl_GetBooleanFromObj(NULL,objv[index+1],&nonblocking) == TCL_OK)) {
+                    index++;
+                }
+                if (nonblocking) {
+                    SYSLOG_ATOMIC_STORE(g_status->options,g_status->options | SYSLOG_NONBLOCKING);
+                } else {
+                    SYSLOG_ATOMIC_STORE(g_status->options,g_status->options & ~SYSLOG_NONBLOCKING);
+                }
                 fchanged++;
                 pao->last_option_index = index;
                 break;
             }
             case log_console_idx:
             {
-                g_status->options = g_status->options | LOG_CONS;
+                SYSLOG_ATOMIC_STORE(g_status->options,g_status->options | LOG_CONS);
                 fchanged++;
                 pao->last_option_index = index;
                 break;
             }
             case log_pid_idx:
             {
-                g_status->options = g_status->options | LOG_PID;
+                SYSLOG_ATOMIC_STORE(g_status->options,g_status->options | LOG_PID);
                 fchanged++;
                 pao->last_option_index = index;
                 break;
             }
             case log_perror_idx:
             {
-                g_status->options = g_status->options | LOG_PERROR;
+                SYSLOG_ATOMIC_STORE(g_status->options,g_status->options | LOG_PERROR);
                 fchanged++;
                 pao->last_option_index = index;
                 break;
@@ -196,12 +423,46 @@ int parse_options (Tcl_Interp *interp, int objc, Tcl_Obj *CONST86 objv[],ParseAr
                     pao->status->facility = f;
                 } else {
                     pao->modified_opt_class |= GLOBAL_OPTION_CLASS;
-                    g_status->facility = f;
+                    SYSLOG_ATOMIC_STORE(g_status->facility,f);
                 }
                 fchanged++;
                 pao->last_option_index = index;
                 break;
             }   
+            case escape_idx:
+            {
+                int mode;
+
+                if (index == objc-1) {
+                    missing_option_value(interp,tcl_command,objv[index]);
+                    return ERROR;
+                }
+                if (Tcl_GetIndexFromObj(interp,objv[++index],escape_modes,"escape mode",0,&mode) != TCL_OK) {
+                    return ERROR;
+                }
+                pao->status->escape = mode;
+                fchanged++;
+                pao->last_option_index = index;
+                break;
+            }
+            case json_idx:
+            {
+                if (index == objc-1) {
+                    missing_option_value(interp,tcl_command,objv[index]);
+                    return ERROR;
+                }
+                pao->json = objv[++index];
+                fchanged++;
+                pao->last_option_index = index;
+                break;
+            }
+            case cee_idx:
+            {
+                pao->cee = true;
+                fchanged++;
+                pao->last_option_index = index;
+                break;
+            }
             case format_idx:
             {
                 if (index == objc-1) {
@@ -209,14 +470,12 @@ int parse_options (Tcl_Interp *interp, int objc, Tcl_Obj *CONST86 objv[],ParseAr
                     return ERROR;
                 }
 
-                const char *format_s = Tcl_GetString(objv[++index]);
-                size_t len = strlen(format_s);
-                char *copy = (char *) Tcl_Alloc(len + 1);
-                memcpy(copy,format_s,len + 1);
-                if ((pao->status->format != NULL) && (pao->status->format != g_default_format)) {
-                    Tcl_Free(pao->status->format);
+                const char *format = intern_acquire_format(Tcl_GetString(objv[++index]));
+
+                if (pao->status->format != g_default_format) {
+                    intern_release(pao->status->format);
                 }
-                pao->status->format = copy;
+                pao->status->format = format;
                 fchanged++;
                 pao->last_option_index = index;
                 break;
@@ -226,3 +485,27 @@ int parse_options (Tcl_Interp *interp, int objc, Tcl_Obj *CONST86 objv[],ParseAr
     }
     return fchanged;
 }
+
+/*
+ * parse_options
+ *
+ * Every call resets the thread facility and format. The format in use
+ * is released only after the arguments are parsed: a -format setting
+ * it again finds it still in the intern table
+ */
+
+int parse_options (Tcl_Interp *interp, int objc, Tcl_Obj *CONST86 objv[],ParseArgsOptions* pao)
+{
+    const char* previous_format = pao->status->format;
+    int         result;
+
+    pao->status->facility = -1;
+    pao->status->format   = g_default_format;
+
+    result = parse_arguments(interp,objc,objv,pao);
+
+    if (previous_format != g_default_format) {
+        intern_release(previous_format);
+    }
+    return result;
+}
@@ -0,0 +1,69 @@
+/*
+ *    probes.h - USDT static probes of the logging path
+ *
+ *    A Tcl interface to the POSIX syslog service.
+ *
+ *    Copyright (C) 2026 Massimo Manghi <mxmanghi@apache.org>
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Probes of provider 'tcl_syslog', built with ./configure --enable-usdt.
+ * The last argument of every probe is the id of the calling thread
+ *
+ *  message__entry (level,facility,length,thread)    message passed the threshold
+ *  message__filtered (level,threshold,thread)       message discarded by the threshold
+ *  message__formatted (level,facility,length,thread) body rendered and escaped
+ *  send__lock (shard,thread)                         waiting for the shard lock
+ *  send__start (shard,length,thread)                 shard lock taken, sending
+ *  send__done (shard,result,thread)                  record sent (result 0) or not
+ *  send__batch (shard,count,thread)                  shard lock taken, sending count records
+ *  send__batch__done (shard,sent,thread)             batch sent, sent records went out
+ *  mutex__acquire (thread)                           waiting for syslogMutex
+ *  mutex__acquired (thread)                          syslogMutex taken
+ *  mutex__release (thread)                           syslogMutex released
+ *
+ *  e.g.: bpftrace -e 'usdt:./libsyslog2.0.2.so:tcl_syslog:send__start { ... }'
+ */
+
+#ifndef __probes_h__
+#define __probes_h__
+
+#ifdef HAVE_USDT_PROBES
+
+#include <stdint.h>
+#include <sys/sdt.h>
+
+#define SYSLOG_PROBE_THREAD ((uintptr_t) Tcl_GetCurrentThread())
+
+#define SYSLOG_PROBE0(name) \
+        DTRACE_PROBE1(tcl_syslog,name,SYSLOG_PROBE_THREAD)
+#define SYSLOG_PROBE1(name,a) \
+        DTRACE_PROBE2(tcl_syslog,name,a,SYSLOG_PROBE_THREAD)
+#define SYSLOG_PROBE2(name,a,b) \
+        DTRACE_PROBE3(tcl_syslog,name,a,b,SYSLOG_PROBE_THREAD)
+#define SYSLOG_PROBE3(name,a,b,c) \
+        DTRACE_PROBE4(tcl_syslog,name,a,b,c,SYSLOG_PROBE_THREAD)
+
+#else
+
+#define SYSLOG_PROBE0(name)
+#define SYSLOG_PROBE1(name,a)
+#define SYSLOG_PROBE2(name,a,b)
+#define SYSLOG_PROBE3(name,a,b,c)
+
+#endif /* HAVE_USDT_PROBES */
+
+#endif /* __probes_h__ */
@@ -0,0 +1,405 @@
+/*
+ *    queue.c - asynchronous delivery of log records
+ *
+ *    A Tcl interface to the POSIX syslog service.
+ *
+ *    Copyright (C) 2026 Massimo Manghi <mxmanghi@apache.org>
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * With ::syslog::open -queue N records are copied in a queue and sent by a
+ * writer thread, the logging thread doesn't wait for the syslog daemon.
+ * The queue has two lanes: records at level critical or above go in the
+ * urgent lane, which the writer always drains first, everything else in
+ * the bulk lane. Records are queued with their header, timestamp included,
+ * formatted when they're logged. The bulk lane holds at most N records,
+ * when it's full the logging threads wait for the writer to catch up. The
+ * urgent lane holds QUEUE_URGENT_SIZE records and is never waited on, so an
+ * emergency message never waits behind a debug flood: when the urgent lane
+ * is full the logging thread sends the record itself (the lane overflow).
+ *
+ * queue_start is called with syslogMutex held, queue_stop by the thread
+ * closing the connection after releasing it (see SyslogClose), the writer
+ * thread never takes syslogMutex. Builds without thread support always
+ * send synchronously
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <string.h>
+#include <syslog.h>
+
+#include "syslog.h"
+#include "transport.h"
+#include "queue.h"
+
+#define URGENT_LANE     0
+#define BULK_LANE       1
+#define NUM_LANES       2
+
+typedef struct QueueRecord {
+    struct QueueRecord* next;
+    unsigned int        shard_hash;
+    int                 length;
+    char                data[];     /* header and body */
+} QueueRecord;
+
+typedef struct QueueLane {
+    QueueRecord*        head;
+    QueueRecord*        tail;
+    int                 depth;
+    int                 peak;           /* highest depth reached */
+    unsigned long       enqueued;
+    unsigned long       sent;
+    unsigned long       dropped;        /* records the writer couldn't send */
+    unsigned long       overflow;       /* records sent directly, the lane was full */
+} QueueLane;
+
+typedef struct QueueSignals {
+    Tcl_Condition       not_empty;
+    Tcl_Condition       not_full;
+} QueueSignals;
+
+static const char*      lane_names[NUM_LANES] = { "urgent", "bulk" };
+static QueueLane        lanes[NUM_LANES];
+static int              capacity = 0;
+static bool             running  = false;
+
+#ifdef TCL_THREADS
+
+static Tcl_Mutex        queue_lock;
+static QueueSignals     queue_signals;
+static QueueSignals*    signals = &queue_signals;  /* replaced in a child process */
+static QueueSignals*    fork_signals = NULL;
+static QueueRecord*     orphans = NULL;            /* the parent's records, in a child */
+static Tcl_ThreadId     writer;
+static bool             sending = false;    /* the writer took a record off its lane */
+
+/*
+ * queue_writer
+ *
+ * Body of the writer thread. It runs until the queue is stopped and
+ * both lanes are drained
+ */
+
+static Tcl_ThreadCreateType queue_writer (ClientData clientData)
+{
+    SyslogThreadStatus status;
+
+    /* the writer status only selects the connection shard */
+
+    memset(&status,0,sizeof(status));
+    for (;;) {
+        QueueRecord*    record;
+        QueueLane*      lane;
+        struct iovec    data;
+
+        Tcl_MutexLock(&queue_lock);
+        sending = false;
+        while (running && (lanes[URGENT_LANE].head == NULL) && (lanes[BULK_LANE].head == NULL)) {
+            Tcl_ConditionWait(&signals->not_empty,&queue_lock,NULL);
+        }
+        lane = (lanes[URGENT_LANE].head != NULL) ? &lanes[URGENT_LANE] : &lanes[BULK_LANE];
+        record = lane->head;
+        if (record == NULL) {
+            Tcl_MutexUnlock(&queue_lock);
+            break;
+        }
+        lane->head = record->next;
+        if (lane->head == NULL) { lane->tail = NULL; }
+        lane->depth--;
+        sending = true;
+        if (lane == &lanes[BULK_LANE]) {
+            Tcl_ConditionNotify(&signals->not_full);
+        }
+        Tcl_MutexUnlock(&queue_lock);
+
+        status.shard_hash = record->shard_hash;
+        data.iov_base = record->data;
+        data.iov_len  = record->length;
+        if (transport_send_records(&status,&data,1) == 1) {
+            SYSLOG_ATOMIC_INCR(lane->sent);
+        } else {
+            SYSLOG_ATOMIC_INCR(lane->dropped);
+        }
+        Tcl_Free((char *) record);
+    }
+    TCL_THREAD_CREATE_RETURN;
+}
+
+static void queue_exit_handler (ClientData clientData)
+{
+    queue_stop();
+}
+
+/*
+ * queue_start
+ *
+ * Starts the writer thread. The bulk lane will hold at most size records
+ *
+ * Returned value: TCL_OK or TCL_ERROR if the thread couldn't be created
+ */
+
+int queue_start (int size)
+{
+    static bool exit_handler = false;
+
+    if (running) { return TCL_OK; }
+
+    while (orphans != NULL) {
+        QueueRecord* record = orphans;
+
+        orphans = record->next;
+        Tcl_Free((char *) record);
+    }
+
+    capacity = size;
+    running  = true;
+    if (Tcl_CreateThread(&writer,queue_writer,NULL,TCL_THREAD_STACK_DEFAULT,TCL_THREAD_JOINABLE) != TCL_OK) {
+        running = false;
+        return TCL_ERROR;
+    }
+
+    /* records still queued are sent before the process exits */
+
+    if (!exit_handler) {
+        Tcl_CreateExitHandler(queue_exit_handler,NULL);
+        exit_handler = true;
+    }
+    return TCL_OK;
+}
+
+/*
+ * queue_stop
+ *
+ * Stops the writer thread after the records queued are sent. Threads
+ * waiting for room in the bulk lane send their record themselves
+ */
+
+void queue_stop (void)
+{
+    int result;
+
+    Tcl_MutexLock(&queue_lock);
+    if (!running) {
+        Tcl_MutexUnlock(&queue_lock);
+        return;
+    }
+    running = false;
+    Tcl_ConditionNotify(&signals->not_empty);
+    Tcl_ConditionNotify(&signals->not_full);
+    Tcl_MutexUnlock(&queue_lock);
+
+    Tcl_JoinThread(writer,&result);
+}
+
+/*
+ * queue_idle
+ *
+ * Whether every record queued so far has gone through the transport:
+ * both lanes are empty and the writer isn't sending one
+ */
+
+bool queue_idle (void)
+{
+    bool idle;
+
+    Tcl_MutexLock(&queue_lock);
+    idle = !running || ((lanes[URGENT_LANE].head == NULL) && (lanes[BULK_LANE].head == NULL) && !sending);
+    Tcl_MutexUnlock(&queue_lock);
+    return idle;
+}
+
+/*
+ * queue_fork_prepare, queue_fork_release, queue_fork_child
+ *
+ * The queue lock is held across fork, taken after syslogMutex and the
+ * intern table lock and before the shard locks (see SyslogForkPrepare).
+ * The writer thread is the parent's and the records queued are sent by
+ * the parent: the child starts with an empty queue, not running, and
+ * restarts it when the connection is reopened. The conditions can't be
+ * reused or destroyed in the child, the parent's threads waiting on them
+ * don't exist there and destroying them would wait for them: the child
+ * switches to a new pair allocated by the parent in queue_fork_prepare,
+ * so that no allocation happens between fork and exec. The old pair is
+ * left behind, a few bytes per fork. The records queued are moved to
+ * the orphans list and freed by queue_start
+ */
+
+void queue_fork_prepare (void)
+{
+    fork_signals = (QueueSignals *) Tcl_Alloc(sizeof(QueueSignals));
+    memset(fork_signals,0,sizeof(QueueSignals));
+    Tcl_MutexLock(&queue_lock);
+}
+
+void queue_fork_release (void)
+{
+    Tcl_MutexUnlock(&queue_lock);
+    if (fork_signals != NULL) {
+        Tcl_Free((char *) fork_signals);
+        fork_signals = NULL;
+    }
+}
+
+void queue_fork_child (void)
+{
+    int l;
+
+    signals = fork_signals;
+    fork_signals = NULL;
+    running = false;
+    sending = false;
+    for (l = 0; l < NUM_LANES; l++) {
+        if (lanes[l].head != NULL) {
+            lanes[l].tail->next = orphans;
+            orphans = lanes[l].head;
+        }
+    }
+    memset(lanes,0,sizeof(lanes));
+}
+
+/*
+ * queue_push
+ *
+ * Formats the record header and copies the record in its lane
+ *
+ * Returned value: false when the queue is not running (or the urgent
+ * lane is full) and the caller has to send the record itself
+ */
+
+bool queue_push (SyslogThreadStatus* status,int pri,struct iovec* body,int nbody)
+{
+    QueueRecord*    record;
+    QueueLane*      lane;
+    char            header[TRANSPORT_HEADER_SIZE];
+    size_t          tag_offset;
+    size_t          header_len;
+    int             length;
+    int             i;
+
+    if (!running) { return false; }
+
+    header_len = transport_header(status,pri,header,sizeof(header),&tag_offset);
+    length = (int) header_len;
+    for (i = 0; i < nbody; i++) {
+        length += body[i].iov_len;
+    }
+    record = (QueueRecord *) Tcl_Alloc(sizeof(QueueRecord) + length);
+    record->next       = NULL;
+    record->shard_hash = status->shard_hash;
+    record->length     = length;
+    memcpy(record->data,header,header_len);
+    for (i = 0, length = (int) header_len; i < nbody; i++) {
+        memcpy(record->data + length,body[i].iov_base,body[i].iov_len);
+        length += body[i].iov_len;
+    }
+
+    lane = (LOG_PRI(pri) <= QUEUE_URGENT_LEVEL) ? &lanes[URGENT_LANE] : &lanes[BULK_LANE];
+
+    Tcl_MutexLock(&queue_lock);
+    if (lane == &lanes[BULK_LANE]) {
+        while (running && (lane->depth >= capacity)) {
+            Tcl_ConditionWait(&signals->not_full,&queue_lock,NULL);
+        }
+    } else if (running && (lane->depth >= QUEUE_URGENT_SIZE)) {
+        lane->overflow++;
+        Tcl_MutexUnlock(&queue_lock);
+        Tcl_Free((char *) record);
+        return false;
+    }
+    if (!running) {
+        Tcl_MutexUnlock(&queue_lock);
+        Tcl_Free((char *) record);
+        return false;
+    }
+
+    if (lane->tail != NULL) {
+        lane->tail->next = record;
+    } else {
+        lane->head = record;
+    }
+    lane->tail = record;
+    lane->depth++;
+    lane->enqueued++;
+    if (lane->depth > lane->peak) { lane->peak = lane->depth; }
+    Tcl_ConditionNotify(&signals->not_empty);
+    Tcl_MutexUnlock(&queue_lock);
+
+    transport_perror(header,header_len,tag_offset,body,nbody);
+    return true;
+}
+
+#else
+
+int queue_start (int size)
+{
+    capacity = size;
+    return TCL_OK;
+}
+
+void queue_stop (void) { }
+
+bool queue_idle (void) { return true; }
+
+void queue_fork_prepare (void) { }
+
+void queue_fork_release (void) { }
+
+void queue_fork_child (void) { }
+
+bool queue_push (SyslogThreadStatus* status,int pri,struct iovec* body,int nbody)
+{
+    return false;
+}
+
+#endif /* TCL_THREADS */
+
+/*
+ * queue_stats
+ *
+ * Returns a dictionary with the size of the bulk lane (-queue) and for
+ * every lane its current depth, the highest depth reached and the
+ * number of records queued and sent
+ */
+
+Tcl_Obj* queue_stats (void)
+{
+    Tcl_Obj*    stats = Tcl_NewDictObj();
+    int         l;
+
+#ifdef TCL_THREADS
+    Tcl_MutexLock(&queue_lock);
+#endif
+    Tcl_DictObjPut(NULL,stats,Tcl_NewStringObj("queue",-1),Tcl_NewIntObj(running ? capacity : 0));
+    for (l = 0; l < NUM_LANES; l++) {
+        Tcl_Obj* lane = Tcl_NewDictObj();
+
+        Tcl_DictObjPut(NULL,lane,Tcl_NewStringObj("depth",-1),Tcl_NewIntObj(lanes[l].depth));
+        Tcl_DictObjPut(NULL,lane,Tcl_NewStringObj("peak",-1),Tcl_NewIntObj(lanes[l].peak));
+        Tcl_DictObjPut(NULL,lane,Tcl_NewStringObj("enqueued",-1),Tcl_NewWideIntObj((Tcl_WideInt) lanes[l].enqueued));
+        Tcl_DictObjPut(NULL,lane,Tcl_NewStringObj("sent",-1),Tcl_NewWideIntObj((Tcl_WideInt) lanes[l].sent));
+        Tcl_DictObjPut(NULL,lane,Tcl_NewStringObj("dropped",-1),Tcl_NewWideIntObj((Tcl_WideInt) lanes[l].dropped));
+        Tcl_DictObjPut(NULL,lane,Tcl_NewStringObj("overflow",-1),Tcl_NewWideIntObj((Tcl_WideInt) lanes[l].overflow));
+        Tcl_DictObjPut(NULL,stats,Tcl_NewStringObj(lane_names[l],-1),lane);
+    }
+#ifdef TCL_THREADS
+    Tcl_MutexUnlock(&queue_lock);
+#endif
+    return stats;
+}
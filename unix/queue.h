@@ -0,0 +1,50 @@
+/*
+ *    queue.h - asynchronous delivery of log records
+ *
+ *    A Tcl interface to the POSIX syslog service.
+ *
+ *    Copyright (C) 2026 Massimo Manghi <mxmanghi@apache.org>
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __queue_h__
+#define __queue_h__
+
+#include <syslog.h>
+#include <sys/uio.h>
+#include "syslog.h"
+
+/* upper bound of -queue */
+
+#define QUEUE_MAX_SIZE          1000000
+
+/* records at this level or above go through the urgent lane */
+
+#define QUEUE_URGENT_LEVEL      LOG_CRIT
+
+/* records the urgent lane can hold, the others are sent right away */
+
+#define QUEUE_URGENT_SIZE       1024
+
+int         queue_start (int size);
+void        queue_stop (void);
+bool        queue_idle (void);
+void        queue_fork_prepare (void);
+void        queue_fork_release (void);
+void        queue_fork_child (void);
+bool        queue_push (SyslogThreadStatus* status,int pri,struct iovec* body,int nbody);
+Tcl_Obj*    queue_stats (void);
+
+#endif /* __queue_h__ */
@@ -0,0 +1,648 @@
+/*
+ *    ring.c - shared memory log ring for multi-process servers
+ *
+ *    A Tcl interface to the POSIX syslog service.
+ *
+ *    Copyright (C) 2026 Massimo Manghi <mxmanghi@apache.org>
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * In prefork servers (Apache with Rivet) every child process would open its
+ * own connection to the syslog daemon. With ::syslog::open -ring name the
+ * processes write their records in a ring of fixed size slots in a POSIX
+ * shared memory object and a single collector sends them in batches on one
+ * connection. The parent opening the ring before forking creates it, the
+ * children inherit the mapping, unrelated processes attach to it by name.
+ *
+ * The ring is a bounded multi-producer queue (D. Vyukov's design): every
+ * slot carries a sequence number telling whether it's free for the producer
+ * claiming position 'pos' (sequence == pos) or holds the record written at
+ * 'pos' (sequence == pos + 1). Producers claim a position with a CAS on
+ * head, the collector claims the records it sends with a CAS on tail. The
+ * atomics are used directly as the ring is shared between processes,
+ * TCL_THREADS or not.
+ *
+ * Every process attached to the ring with thread support runs a collector
+ * thread, but only one of them at a time is active: the one whose pid is
+ * stored in the ring header. The others stand by and take over when the
+ * active collector stops updating its heartbeat (the process exited or
+ * crashed, or its send is stuck for RING_TAKEOVER_MS: claiming the tail
+ * with a CAS the two collectors never send the same record). The records
+ * already in the ring outlive the process that wrote them. A slot claimed
+ * by a process that died before filling it is skipped after RING_STUCK_MS.
+ *
+ * Records not fitting a slot, or finding the ring full, are sent directly.
+ *
+ * The logging threads use the mapping without syslogMutex: ring_push and
+ * ring_stats enter the ring incrementing ring_users and ring_detach, once
+ * ring_mapped is cleared, waits for them to leave before unmapping it
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <syslog.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "syslog.h"
+#include "transport.h"
+#include "ring.h"
+
+#define RING_MAGIC          0x53594c52      /* 'SYLR' */
+#define RING_CACHE_LINE     64
+#define RING_BATCH          TRANSPORT_MAX_BATCH     /* records sent by the collector at once */
+#define RING_IDLE_US        1000            /* collector sleep on an empty ring */
+#define RING_STANDBY_MS     100             /* period of the standby collector checks */
+#define RING_TAKEOVER_MS    2000            /* heartbeat age making the collector dead */
+#define RING_STUCK_MS       1000            /* age of a claimed slot never filled */
+
+typedef struct RingSlot {
+    uint64_t    sequence;
+    int32_t     pid;        /* producer that claimed the slot, 0 when free */
+    int32_t     length;
+    char        data[RING_SLOT_SIZE - 16];
+} RingSlot;
+
+typedef struct RingHeader {
+    uint32_t    magic;      /* stored last by the creator */
+    uint32_t    nslots;
+    int32_t     collector_pid;
+    int32_t     creator_pid;
+    int64_t     heartbeat_ms;
+    uint64_t    written;    /* records pushed in the ring */
+    uint64_t    overflow;   /* records sent directly (ring full or record too long) */
+    uint64_t    collected;  /* records sent by the collectors */
+    uint64_t    lost;       /* slots skipped because their producer died */
+    char        pad1[RING_CACHE_LINE];
+    uint64_t    head;       /* next position claimed by producers */
+    char        pad2[RING_CACHE_LINE - sizeof(uint64_t)];
+    uint64_t    tail;       /* next position read by the collector */
+    char        pad3[RING_CACHE_LINE - sizeof(uint64_t)];
+} RingHeader;
+
+#define RING_LOAD(v)            __atomic_load_n(&(v),__ATOMIC_ACQUIRE)
+#define RING_STORE(v,x)         __atomic_store_n(&(v),(x),__ATOMIC_RELEASE)
+#define RING_INCR(v,n)          __atomic_add_fetch(&(v),(n),__ATOMIC_RELAXED)
+#define RING_CAS(v,e,d)         __atomic_compare_exchange_n(&(v),&(e),(d),false,__ATOMIC_ACQ_REL,__ATOMIC_RELAXED)
+
+static RingHeader*      ring        = NULL;
+static RingSlot*        slots       = NULL;
+static size_t           ring_size   = 0;
+static char*            ring_name   = NULL;
+static pid_t            ring_pid    = 0;    /* process that mapped the ring */
+static bool             ring_mapped = false;
+static int              ring_users  = 0;    /* threads using the mapping */
+
+static int64_t ring_now_ms (void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC,&ts);
+    return (int64_t) ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/*
+ * ring_enter
+ *
+ * A thread about to use the mapping announces itself before checking
+ * it's still there (sequentially consistent with ring_detach clearing
+ * ring_mapped and then reading ring_users)
+ *
+ * Returned value: true when the ring can be used until ring_leave
+ */
+
+static bool ring_enter (void)
+{
+    __atomic_add_fetch(&ring_users,1,__ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&ring_mapped,__ATOMIC_SEQ_CST)) { return true; }
+    __atomic_sub_fetch(&ring_users,1,__ATOMIC_RELEASE);
+    return false;
+}
+
+static void ring_leave (void)
+{
+    __atomic_sub_fetch(&ring_users,1,__ATOMIC_RELEASE);
+}
+
+static bool ring_pid_dead (pid_t pid)
+{
+    return ((kill(pid,0) < 0) && (errno == ESRCH));
+}
+
+#ifdef TCL_THREADS
+
+static Tcl_ThreadId     collector;
+static bool             collector_running = false;
+
+/*
+ * ring_release_slots
+ *
+ * Makes count slots starting at position tail available to the
+ * producers of the next round
+ */
+
+static void ring_release_slots (uint64_t tail,int count)
+{
+    int i;
+
+    for (i = 0; i < count; i++) {
+        RingSlot* slot = &slots[(tail + i) & (ring->nslots - 1)];
+
+        __atomic_store_n(&slot->pid,0,__ATOMIC_RELAXED);
+        RING_STORE(slot->sequence,tail + i + ring->nslots);
+    }
+}
+
+/*
+ * ring_collect
+ *
+ * Claims and sends a batch of the records at the tail of the ring.
+ * stuck_since keeps the time a claimed slot was first found not
+ * filled yet
+ *
+ * Returned value: number of slots consumed (or claimed by another
+ * collector), 0 when there was nothing to do
+ */
+
+static int ring_collect (SyslogThreadStatus* status,int64_t* stuck_since)
+{
+    struct iovec    records[RING_BATCH];
+    uint64_t        tail = RING_LOAD(ring->tail);
+    int             count = 0;
+
+    while (count < RING_BATCH) {
+        RingSlot* slot = &slots[(tail + count) & (ring->nslots - 1)];
+
+        if (RING_LOAD(slot->sequence) != tail + count + 1) { break; }
+        records[count].iov_base = slot->data;
+        records[count].iov_len  = slot->length;
+        count++;
+    }
+
+    if (count > 0) {
+        *stuck_since = 0;
+        if (!RING_CAS(ring->tail,tail,tail + count)) { return count; }
+        transport_send_records(status,records,count);
+        ring_release_slots(tail,count);
+        RING_INCR(ring->collected,count);
+        return count;
+    }
+
+    /* nothing to send: is the slot at the tail claimed and never filled? */
+
+    if (RING_LOAD(ring->head) != tail) {
+        RingSlot*   slot = &slots[tail & (ring->nslots - 1)];
+        int64_t     now  = ring_now_ms();
+        pid_t       pid  = __atomic_load_n(&slot->pid,__ATOMIC_RELAXED);
+
+        if (*stuck_since == 0) {
+            *stuck_since = now;
+        } else if ((now - *stuck_since > RING_STUCK_MS) && (pid != 0) && ring_pid_dead(pid)) {
+            *stuck_since = 0;
+            if (RING_CAS(ring->tail,tail,tail + 1)) {
+                ring_release_slots(tail,1);
+                RING_INCR(ring->lost,1);
+            }
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/*
+ * ring_collector
+ *
+ * Body of the collector thread. It stands by until its process is elected
+ * collector, then sends the records until the ring is detached. On the way
+ * out the ring is drained and the collector role given up
+ */
+
+static Tcl_ThreadCreateType ring_collector (ClientData clientData)
+{
+    SyslogThreadStatus  status;
+    pid_t               pid = getpid();
+    int64_t             stuck_since = 0;
+    struct timespec     idle = { 0, RING_IDLE_US * 1000 };
+    struct timespec     standby = { 0, RING_STANDBY_MS * 1000000 };
+
+    memset(&status,0,sizeof(status));
+    status.shard_hash = transport_shard_hash();
+
+    while (__atomic_load_n(&collector_running,__ATOMIC_ACQUIRE)) {
+        int32_t active = RING_LOAD(ring->collector_pid);
+        int64_t now    = ring_now_ms();
+
+        if (active != pid) {
+            if (((active == 0) || (now - RING_LOAD(ring->heartbeat_ms) > RING_TAKEOVER_MS)) &&
+                RING_CAS(ring->collector_pid,active,pid)) {
+                RING_STORE(ring->heartbeat_ms,now);
+                continue;
+            }
+            nanosleep(&standby,NULL);
+            continue;
+        }
+
+        RING_STORE(ring->heartbeat_ms,now);
+        if (ring_collect(&status,&stuck_since) == 0) {
+            nanosleep(&idle,NULL);
+        }
+    }
+
+    if (RING_LOAD(ring->collector_pid) == pid) {
+        while (ring_collect(&status,&stuck_since) > 0) { }
+
+        int32_t active = pid;
+        RING_CAS(ring->collector_pid,active,0);
+    }
+    TCL_THREAD_CREATE_RETURN;
+}
+
+#endif /* TCL_THREADS */
+
+/*
+ * ring_map
+ *
+ * Opens the shared memory object name creating it when it doesn't
+ * exist. The process creating it initializes the header, the others
+ * wait for the magic number before using the ring
+ *
+ * Returned value: TCL_OK or ERROR (errno is set)
+ */
+
+static int ring_map (const char* name,int nslots)
+{
+    struct stat st;
+    bool        creator = true;
+    int         fd;
+    int         wait;
+
+    fd = shm_open(name,O_RDWR|O_CREAT|O_EXCL,0600);
+    if ((fd < 0) && (errno == EEXIST)) {
+        creator = false;
+        fd = shm_open(name,O_RDWR,0600);
+    }
+    if (fd < 0) { return ERROR; }
+
+    if (creator) {
+        ring_size = sizeof(RingHeader) + (size_t) nslots * sizeof(RingSlot);
+        if (ftruncate(fd,ring_size) < 0) {
+            int error = errno;
+
+            close(fd);
+            shm_unlink(name);
+            errno = error;
+            return ERROR;
+        }
+    } else {
+
+        /* the creator might still be sizing the object */
+
+        for (wait = 0; wait < 100; wait++) {
+            if ((fstat(fd,&st) == 0) && ((size_t) st.st_size > sizeof(RingHeader))) { break; }
+            usleep(10000);
+        }
+        ring_size = (size_t) st.st_size;
+        if (ring_size <= sizeof(RingHeader)) {
+            close(fd);
+            errno = EINVAL;
+            return ERROR;
+        }
+    }
+
+    ring = (RingHeader *) mmap(NULL,ring_size,PROT_READ|PROT_WRITE,MAP_SHARED,fd,0);
+    close(fd);
+    if (ring == MAP_FAILED) {
+        ring = NULL;
+        return ERROR;
+    }
+    slots = (RingSlot *) (ring + 1);
+
+    if (creator) {
+        uint64_t i;
+
+        for (i = 0; i < (uint64_t) nslots; i++) {
+            slots[i].sequence = i;
+            slots[i].pid      = 0;
+        }
+        ring->nslots      = nslots;
+        ring->creator_pid = getpid();
+        RING_STORE(ring->magic,RING_MAGIC);
+    } else {
+        for (wait = 0; (wait < 100) && (RING_LOAD(ring->magic) != RING_MAGIC); wait++) {
+            usleep(10000);
+        }
+        if ((RING_LOAD(ring->magic) != RING_MAGIC) ||
+            (sizeof(RingHeader) + (size_t) ring->nslots * sizeof(RingSlot) > ring_size)) {
+            munmap(ring,ring_size);
+            ring = NULL;
+            errno = EINVAL;
+            return ERROR;
+        }
+    }
+    return TCL_OK;
+}
+
+/*
+ * ring_attach
+ *
+ * Maps the ring name (nslots is rounded up to a power of 2 and only
+ * used by the process creating the ring) and starts the collector
+ * thread. Called with syslogMutex held
+ *
+ * Returned value: TCL_OK or TCL_ERROR
+ */
+
+int ring_attach (Tcl_Interp* interp,const char* name,int nslots)
+{
+    int size = RING_MIN_SLOTS;
+
+    ring_detach();
+    while (size < nslots) { size <<= 1; }
+
+    ring_name = Tcl_Alloc(strlen(name) + 2);
+    if (name[0] == '/') {
+        strcpy(ring_name,name);
+    } else {
+        ring_name[0] = '/';
+        strcpy(ring_name + 1,name);
+    }
+
+    if (ring_map(ring_name,size) != TCL_OK) {
+        if (interp != NULL) {
+            Tcl_SetObjResult(interp,Tcl_ObjPrintf("couldn't attach the log ring '%s': %s",
+                                                  ring_name,Tcl_PosixError(interp)));
+        }
+        Tcl_Free(ring_name);
+        ring_name = NULL;
+        return TCL_ERROR;
+    }
+    ring_pid = getpid();
+    __atomic_store_n(&ring_mapped,true,__ATOMIC_SEQ_CST);
+
+#ifdef TCL_THREADS
+    collector_running = true;
+    if (Tcl_CreateThread(&collector,ring_collector,NULL,
+                         TCL_THREAD_STACK_DEFAULT,TCL_THREAD_JOINABLE) != TCL_OK) {
+        collector_running = false;
+    }
+#endif
+    return TCL_OK;
+}
+
+/*
+ * ring_detach
+ *
+ * Stops the collector thread (draining the ring if it was the active
+ * collector) and unmaps the ring. The process that created the ring
+ * also removes its name. A child process only unmaps the ring it
+ * inherited: the collector thread is its parent's. Called by the
+ * thread closing the connection without syslogMutex (see SyslogClose)
+ */
+
+void ring_detach (void)
+{
+    struct timespec pause = { 0, 100000 };
+
+    if (ring == NULL) { return; }
+
+    __atomic_store_n(&ring_mapped,false,__ATOMIC_SEQ_CST);
+    while (__atomic_load_n(&ring_users,__ATOMIC_SEQ_CST) > 0) {
+        nanosleep(&pause,NULL);
+    }
+
+    if (ring_pid == getpid()) {
+#ifdef TCL_THREADS
+        if (collector_running) {
+            int result;
+
+            __atomic_store_n(&collector_running,false,__ATOMIC_RELEASE);
+            Tcl_JoinThread(collector,&result);
+        }
+#endif
+        if (ring->creator_pid == ring_pid) {
+            shm_unlink(ring_name);
+        }
+    }
+#ifdef TCL_THREADS
+    collector_running = false;
+#endif
+
+    munmap(ring,ring_size);
+    ring  = NULL;
+    slots = NULL;
+    Tcl_Free(ring_name);
+    ring_name = NULL;
+}
+
+/*
+ * ring_fork_child
+ *
+ * Called in a child process right after fork. The child keeps the
+ * mapping, the collector thread and the threads using the ring are
+ * the parent's. A ring the parent was detaching is forgotten
+ */
+
+void ring_fork_child (void)
+{
+#ifdef TCL_THREADS
+    collector_running = false;
+#endif
+    ring_users = 0;
+    if (!ring_mapped) {
+        ring      = NULL;
+        slots     = NULL;
+        ring_name = NULL;
+    }
+}
+
+bool ring_attached (void)
+{
+    return __atomic_load_n(&ring_mapped,__ATOMIC_ACQUIRE);
+}
+
+/*
+ * ring_claim
+ *
+ * Claims the slot at the head of the ring. The producer first takes the
+ * slot storing its pid, then moves head past it: a slot behind head always
+ * carries the pid of its producer and the collector can tell whether it
+ * died before filling it. A producer taking the slot with a stale head
+ * gives it back, one dying before moving head is detected by the next
+ * producer finding the slot still taken
+ *
+ * Returned value: the slot claimed, NULL when the ring is full
+ */
+
+static RingSlot* ring_claim (uint64_t* claimed)
+{
+    int32_t     pid = (int32_t) getpid();
+    uint64_t    pos = __atomic_load_n(&ring->head,__ATOMIC_RELAXED);
+    int         spins = 0;
+
+    for (;;) {
+        RingSlot*   slot = &slots[pos & (ring->nslots - 1)];
+        int64_t     diff = (int64_t) (RING_LOAD(slot->sequence) - pos);
+        int32_t     owner = 0;
+
+        if (diff < 0) { return NULL; }
+        if ((diff == 0) && RING_CAS(slot->pid,owner,pid)) {
+            if (RING_CAS(ring->head,pos,pos + 1)) {
+                *claimed = pos;
+                return slot;
+            }
+            RING_STORE(slot->pid,0);
+        } else if ((diff == 0) && (++spins % 1024 == 0) &&
+                   (RING_LOAD(ring->head) == pos) && ring_pid_dead(owner)) {
+            RING_CAS(slot->pid,owner,0);
+        }
+        pos = __atomic_load_n(&ring->head,__ATOMIC_RELAXED);
+    }
+}
+
+/*
+ * ring_write
+ *
+ * Writes a record in the ring. The header is formatted first to check
+ * whether the record fits a slot, then a position is claimed and the
+ * record copied in the slot
+ *
+ * Returned value: true if the record was written in the ring, false
+ * when it must be sent directly
+ */
+
+static bool ring_write (SyslogThreadStatus* status,int pri,struct iovec* body,int nbody)
+{
+    char        header[TRANSPORT_HEADER_SIZE];
+    size_t      tag_offset;
+    size_t      header_len = transport_header(status,pri,header,sizeof(header),&tag_offset);
+    size_t      length = header_len;
+    RingSlot*   slot;
+    uint64_t    pos;
+    char*       p;
+    int         i;
+
+    for (i = 0; i < nbody; i++) {
+        length += body[i].iov_len;
+    }
+    if (length > sizeof(slot->data)) {
+        RING_INCR(ring->overflow,1);
+        return false;
+    }
+
+    slot = ring_claim(&pos);
+    if (slot == NULL) {
+        RING_INCR(ring->overflow,1);
+        return false;
+    }
+
+    memcpy(slot->data,header,header_len);
+    p = slot->data + header_len;
+    for (i = 0; i < nbody; i++) {
+        memcpy(p,body[i].iov_base,body[i].iov_len);
+        p += body[i].iov_len;
+    }
+    slot->length = (int32_t) length;
+    RING_STORE(slot->sequence,pos + 1);
+    RING_INCR(ring->written,1);
+
+    /* the collector might be another process: -perror is ours */
+
+    transport_perror(header,header_len,tag_offset,body,nbody);
+    return true;
+}
+
+/*
+ * ring_push
+ *
+ * Writes a record in the ring if it's still attached, see ring_write
+ */
+
+bool ring_push (SyslogThreadStatus* status,int pri,struct iovec* body,int nbody)
+{
+    bool pushed;
+
+    if (!ring_enter()) { return false; }
+    pushed = ring_write(status,pri,body,nbody);
+    ring_leave();
+    return pushed;
+}
+
+/*
+ * ring_written, ring_collected
+ *
+ * ring_written returns the number of records written in the ring by all
+ * the processes, ring_collected whether as many have been sent by the
+ * collectors (or skipped as lost). Without a ring there is nothing to
+ * wait for
+ */
+
+Tcl_WideInt ring_written (void)
+{
+    Tcl_WideInt written = 0;
+
+    if (ring_enter()) {
+        written = (Tcl_WideInt) RING_LOAD(ring->written);
+        ring_leave();
+    }
+    return written;
+}
+
+bool ring_collected (Tcl_WideInt written)
+{
+    bool collected = true;
+
+    if (ring_enter()) {
+        collected = ((Tcl_WideInt) (RING_LOAD(ring->collected) + RING_LOAD(ring->lost)) >= written);
+        ring_leave();
+    }
+    return collected;
+}
+
+/*
+ * ring_stats
+ *
+ * Returns a dictionary with the ring name and size, the records in it
+ * and the counters kept in the ring header (shared by all the processes)
+ */
+
+Tcl_Obj* ring_stats (void)
+{
+    Tcl_Obj* stats = Tcl_NewDictObj();
+
+    if (!ring_enter()) {
+        return stats;
+    }
+    Tcl_DictObjPut(NULL,stats,Tcl_NewStringObj("name",-1),Tcl_NewStringObj(ring_name,-1));
+    Tcl_DictObjPut(NULL,stats,Tcl_NewStringObj("slots",-1),Tcl_NewIntObj(ring->nslots));
+    Tcl_DictObjPut(NULL,stats,Tcl_NewStringObj("depth",-1),
+                   Tcl_NewWideIntObj((Tcl_WideInt) (RING_LOAD(ring->head) - RING_LOAD(ring->tail))));
+    Tcl_DictObjPut(NULL,stats,Tcl_NewStringObj("collector",-1),Tcl_NewIntObj(RING_LOAD(ring->collector_pid)));
+    Tcl_DictObjPut(NULL,stats,Tcl_NewStringObj("written",-1),Tcl_NewWideIntObj((Tcl_WideInt) RING_LOAD(ring->written)));
+    Tcl_DictObjPut(NULL,stats,Tcl_NewStringObj("collected",-1),Tcl_NewWideIntObj((Tcl_WideInt) RING_LOAD(ring->collected)));
+    Tcl_DictObjPut(NULL,stats,Tcl_NewStringObj("overflow",-1),Tcl_NewWideIntObj((Tcl_WideInt) RING_LOAD(ring->overflow)));
+    Tcl_DictObjPut(NULL,stats,Tcl_NewStringObj("lost",-1),Tcl_NewWideIntObj((Tcl_WideInt) RING_LOAD(ring->lost)));
+    ring_leave();
+    return stats;
+}
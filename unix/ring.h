@@ -0,0 +1,47 @@
+/*
+ *    ring.h - shared memory log ring for multi-process servers
+ *
+ *    A Tcl interface to the POSIX syslog service.
+ *
+ *    Copyright (C) 2026 Massimo Manghi <mxmanghi@apache.org>
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __ring_h__
+#define __ring_h__
+
+#include <sys/uio.h>
+#include "syslog.h"
+
+/* a slot holds a whole record (header included) up to this size */
+
+#define RING_SLOT_SIZE          2048
+
+/* bounds and default of -ringslots */
+
+#define RING_MIN_SLOTS          16
+#define RING_MAX_SLOTS          65536
+#define RING_DEFAULT_SLOTS      1024
+
+int         ring_attach (Tcl_Interp* interp,const char* name,int nslots);
+void        ring_detach (void);
+void        ring_fork_child (void);
+bool        ring_attached (void);
+bool        ring_push (SyslogThreadStatus* status,int pri,struct iovec* body,int nbody);
+Tcl_WideInt ring_written (void);
+bool        ring_collected (Tcl_WideInt written);
+Tcl_Obj*    ring_stats (void);
+
+#endif /* __ring_h__ */
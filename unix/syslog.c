@@ -35,16 +35,27 @@
 #define SYSLOG_MAGIC 0x5359534c 
 #endif
 
+#include <stdio.h>
 #include <string.h>
 #include <syslog.h>
 #include <tcl.h>
 #include <sys/param.h>
+#ifdef HAVE_PTHREAD_ATFORK
+#include <pthread.h>
+#endif
 
 #include "syslog.h"
 #include "params.h"
+#include "transport.h"
+#include "ring.h"
+#include "format.h"
+#include "tclSyslog.h"
+#include "queue.h"
 
 static Tcl_ThreadDataKey syslogKey;
 static Tcl_Mutex syslogMutex;
+static Tcl_Condition syslogClosed;
+static bool closing = false;
 
 /*
  * Function Prototypes
@@ -57,11 +68,15 @@ static int SyslogLogmaskCmd (ClientData clientData, Tcl_Interp *interp, int objc
 static int SyslogConfigureCmd (ClientData clientData, Tcl_Interp *interp, int objc, Tcl_Obj *CONST86 objv[]);
 static int SyslogCGetCmd (ClientData clientData, Tcl_Interp *interp, int objc, Tcl_Obj *CONST86 objv[]);
 static int SyslogLogCmd (ClientData clientData, Tcl_Interp *interp, int objc, Tcl_Obj *CONST86 objv[]);
+static int SyslogContextCmd (ClientData clientData, Tcl_Interp *interp, int objc, Tcl_Obj *CONST86 objv[]);
+static int SyslogStatsCmd (ClientData clientData, Tcl_Interp *interp, int objc, Tcl_Obj *CONST86 objv[]);
 
 static void SyslogInitGlobal (void);
 
 extern SyslogGlobalStatus *g_status;
 extern char* g_default_format;
+extern const char* escape_modes[];
+extern const SyslogStubs syslogStubs;
 
 /*
  * Function Bodies
@@ -69,25 +84,68 @@ extern char* g_default_format;
 
 static void SyslogInitGlobal (void) {
     g_status->ident      = NULL;
+    g_status->socket_path = NULL;
+    g_status->max_size   = 0;
+    g_status->connections = 1;
+    g_status->queue_size = 0;
+    g_status->sndbuf     = 0;
+    g_status->send_timeout = 0;
+    g_status->ring_name  = NULL;
+    g_status->ring_slots = RING_DEFAULT_SLOTS;
     g_status->facility   = LOG_USER;
     g_status->options    = LOG_ODELAY;
     g_status->opened     = false;
 }
 
-static void SyslogInitStatus (SyslogThreadStatus *status)
+void SyslogFinalizeStatus (ClientData clientData)
 {
-    status->format       = (char *) g_default_format;
+    SyslogThreadStatus *status = (SyslogThreadStatus *) clientData;
+
+    Tcl_DStringFree(&status->render);
+    Tcl_DStringFree(&status->structured);
+    Tcl_DStringFree(&status->escaped);
+    Tcl_DStringFree(&status->context_prefix);
+    if (status->format != g_default_format) {
+        intern_release(status->format);
+        status->format = g_default_format;
+    }
+    if (status->context != NULL) {
+        Tcl_DecrRefCount(status->context);
+        status->context = NULL;
+    }
+}
+
+void SyslogInitStatus (SyslogThreadStatus *status)
+{
+    if (status->initialized) {
+        SyslogFinalizeStatus((ClientData) status);
+    }
+    Tcl_DStringInit(&status->render);
+    Tcl_DStringInit(&status->structured);
+    Tcl_DStringInit(&status->escaped);
+    Tcl_DStringInit(&status->context_prefix);
+
+    status->format       = g_default_format;
     status->level        = LOG_INFO;
     status->facility     = -1;
+    status->escape       = ESCAPE_NONE;
+    status->is_structured = false;
+    status->is_formatted  = false;
+    status->context      = NULL;
     status->initialized  = true;
     status->message      = NULL;
+    status->message_len  = 0;
+    status->message_obj  = NULL;
+    status->generation   = msgcache_thread_generation();
+    status->timestamp_sec = 0;
+    status->shard_hash   = transport_shard_hash();
 #ifdef TCL_SYSLOG_DEBUG
     status->magic        = SYSLOG_MAGIC;
     status->count        = 0;
 #endif
 }
 
-static SyslogThreadStatus* get_thread_status(void) {
+SyslogThreadStatus* get_thread_status(void) {
     SyslogThreadStatus *status = (SyslogThreadStatus *) Tcl_GetThreadData(&syslogKey, sizeof(SyslogThreadStatus));
 
 #ifdef TCL_SYSLOG_DEBUG
@@ -103,23 +161,104 @@ static SyslogThreadStatus* get_thread_status(void) {
 #endif
 
     if (!status->initialized) {
+        Tcl_CreateThreadExitHandler(SyslogFinalizeStatus,(ClientData) status);
         SyslogInitStatus(status);
     }
     return status;
 }
 
-static void init_parse_options(ParseArgsOptions* pao)
+/*
+ * get_interp_status
+ *
+ * Every interpreter loading the package has a status of its own
+ * (level, facility, format, context...) stored as its assoc data and
+ * passed to the commands as their client data. The status of the
+ * thread (get_thread_status) is only used by the C interface
+ */
+
+static void SyslogDeleteStatus (ClientData clientData,Tcl_Interp* interp)
+{
+    SyslogFinalizeStatus(clientData);
+    Tcl_Free((char *) clientData);
+}
+
+static SyslogThreadStatus* get_interp_status (Tcl_Interp* interp)
+{
+    SyslogThreadStatus* status = (SyslogThreadStatus *) Tcl_GetAssocData(interp,SYSLOG_ASSOC_KEY,NULL);
+
+    if (status == NULL) {
+        status = (SyslogThreadStatus *) Tcl_Alloc(sizeof(SyslogThreadStatus));
+        memset(status,0,sizeof(SyslogThreadStatus));
+        Tcl_SetAssocData(interp,SYSLOG_ASSOC_KEY,SyslogDeleteStatus,(ClientData) status);
+    }
+    return status;
+}
+
+static void init_parse_options(ParseArgsOptions* pao,SyslogThreadStatus* status)
 {
-    pao->status = get_thread_status();
+    pao->status = status;
     pao->last_option_index = 0;
     pao->unhandled_opt_index = 0;
     pao->option_class = ALL_OPTION_CLASSES;
     pao->modified_opt_class = 0;
     pao->facility_is_private = true;
+    pao->json = NULL;
+    pao->cee = false;
+}
+
+#ifdef HAVE_PTHREAD_ATFORK
+
+/*
+ * Fork handlers
+ *
+ * Every lock of the package is held across fork, taken in a fixed order:
+ * syslogMutex, the intern table lock, the queue lock, the shard locks in
+ * index order and the control file lock, released in reverse order. The
+ * child finds the global status, the interned strings, the queue and the
+ * connections consistent and no lock held by a thread that doesn't exist
+ * there. A thread sending holds its shard lock, so fork waits for a send
+ * to a stuck daemon to time out (-sendtimeout, -nonblocking). The child
+ * drops the parent's sockets, queued records and writer thread and marks
+ * the connection closed. The first message it logs reopens it (see
+ * log_message) restarting the writer thread. The ring mapping is
+ * inherited and kept, the collector is the parent's
+ */
+
+static void SyslogForkPrepare (void)
+{
+    SYSLOG_MUTEX_LOCK
+    intern_fork_prepare();
+    queue_fork_prepare();
+    transport_fork_prepare();
+    threshold_fork_prepare();
 }
 
+static void SyslogForkParent (void)
+{
+    threshold_fork_release();
+    transport_fork_release();
+    queue_fork_release();
+    intern_fork_release();
+    SYSLOG_MUTEX_UNLOCK
+}
 
-int Syslog_Init(Tcl_Interp *interp) {
+static void SyslogForkChild (void)
+{
+    transport_fork_child();
+    queue_fork_child();
+    ring_fork_child();
+    g_status->opened = false;
+    closing = false;
+    threshold_fork_release();
+    transport_fork_release();
+    queue_fork_release();
+    intern_fork_release();
+    SYSLOG_MUTEX_UNLOCK
+}
+
+#endif /* HAVE_PTHREAD_ATFORK */
+
+DLLEXPORT int Syslog_Init(Tcl_Interp *interp) {
     SyslogThreadStatus* status;
 
     if (Tcl_InitStubs(interp, "8.6-10", 0) == NULL) {
@@ -130,26 +269,34 @@ int Syslog_Init(Tcl_Interp *interp) {
     if (g_status == NULL) {
         g_status = (SyslogGlobalStatus*) Tcl_Alloc(sizeof(SyslogGlobalStatus));
         SyslogInitGlobal();
+        transport_init();
+#ifdef HAVE_PTHREAD_ATFORK
+        pthread_atfork(SyslogForkPrepare,SyslogForkParent,SyslogForkChild);
+#endif
     }
     SYSLOG_MUTEX_UNLOCK
 
-    status = get_thread_status();
+    status = get_interp_status(interp);
     SyslogInitStatus(status);
 
     /* Let's create the syslog namespace */
 
-    Tcl_CreateObjCommand(interp,PACKAGE_NAME,SyslogCmd,(ClientData) NULL,NULL);
-    Tcl_CreateObjCommand(interp,SYSLOG_NS"::open",SyslogOpenCmd,(ClientData) NULL,NULL);
-    Tcl_CreateObjCommand(interp,SYSLOG_NS"::logmask",SyslogLogmaskCmd,(ClientData) NULL,NULL);
-    Tcl_CreateObjCommand(interp,SYSLOG_NS"::close",SyslogCloseCmd,(ClientData) NULL,NULL);
-    Tcl_CreateObjCommand(interp,SYSLOG_NS"::configure",SyslogConfigureCmd,(ClientData) "cget",NULL);
-    Tcl_CreateObjCommand(interp,SYSLOG_NS"::cget",SyslogCGetCmd,(ClientData) "cget",NULL);
-    Tcl_CreateObjCommand(interp,SYSLOG_NS"::log",SyslogLogCmd,(ClientData) NULL,NULL);
-    Tcl_PkgProvide(interp,PACKAGE_NAME,PACKAGE_VERSION);
+    Tcl_CreateObjCommand(interp,PACKAGE_NAME,SyslogCmd,(ClientData) status,NULL);
+    Tcl_CreateObjCommand(interp,SYSLOG_NS"::open",SyslogOpenCmd,(ClientData) status,NULL);
+    Tcl_CreateObjCommand(interp,SYSLOG_NS"::logmask",SyslogLogmaskCmd,(ClientData) status,NULL);
+    Tcl_CreateObjCommand(interp,SYSLOG_NS"::close",SyslogCloseCmd,(ClientData) status,NULL);
+    Tcl_CreateObjCommand(interp,SYSLOG_NS"::configure",SyslogConfigureCmd,(ClientData) status,NULL);
+    Tcl_CreateObjCommand(interp,SYSLOG_NS"::cget",SyslogCGetCmd,(ClientData) status,NULL);
+    Tcl_CreateObjCommand(interp,SYSLOG_NS"::log",SyslogLogCmd,(ClientData) status,NULL);
+    Tcl_CreateObjCommand(interp,SYSLOG_NS"::channel",SyslogChannelCmd,(ClientData) NULL,NULL);
+    Tcl_CreateObjCommand(interp,SYSLOG_NS"::context",SyslogContextCmd,(ClientData) status,NULL);
+    Tcl_CreateObjCommand(interp,SYSLOG_NS"::stats",SyslogStatsCmd,(ClientData) status,NULL);
+    Tcl_CreateObjCommand(interp,SYSLOG_NS"::bench",SyslogBenchCmd,(ClientData) NULL,NULL);
+    Tcl_PkgProvideEx(interp,PACKAGE_NAME,PACKAGE_VERSION,(ClientData) &syslogStubs);
     return TCL_OK;
 }
 
-int syslog_Init(Tcl_Interp *interp) {
+DLLEXPORT int syslog_Init(Tcl_Interp *interp) {
     return Syslog_Init(interp);
 }
 
@@ -159,7 +306,7 @@ int syslog_Init(Tcl_Interp *interp) {
 
 static void wrong_arguments_message (Tcl_Interp* interp,int c,Tcl_Obj *CONST86 objv[],char* command)
 {
-    char* fixture = "?-ident ident? ?-facility facility? ?-pid? ?-perror? ?-level level? message";
+    char* fixture = "?-ident ident? ?-socket path? ?-facility facility? ?-pid? ?-perror? ?-level level? ?-json dict? ?-cee? message";
     char  cmd_template[512];
 
     strcpy(cmd_template,command);
@@ -197,33 +344,455 @@ static void wrong_command_option(Tcl_Interp *interp, int objc, Tcl_Obj *const ob
     return;
 }
 
-static void SyslogOpen(void)
+/*
+ * SyslogOpen
+ *
+ * Opens the transport and starts the delivery machinery: the log ring
+ * when -ring is set, otherwise the writer thread of -queue. interp is
+ * NULL when the connection is opened by the first message logged
+ *
+ * Returned value: TCL_OK or TCL_ERROR if the ring couldn't be attached
+ * (the message is left in interp when not NULL). Records are then sent
+ * directly
+ */
+
+static int SyslogOpen(Tcl_Interp* interp)
 {
+    int result = TCL_OK;
+
+    while (closing) {
+        Tcl_ConditionWait(&syslogClosed,&syslogMutex,NULL);
+    }
     if (!g_status->opened) {
-        SYSLOG_DEBUG_MSG("Calling openlog")
-        openlog(g_status->ident,g_status->options,g_status->facility);
-        g_status->opened = true;
+        SYSLOG_DEBUG_MSG("Opening transport")
+        transport_open();
+
+        /*
+         * a child process reopening on its first message keeps the ring
+         * it inherited, whose records are sent by the parent's collector
+         */
+
+        if (g_status->ring_name != NULL) {
+            if ((interp != NULL) || !ring_attached()) {
+                result = ring_attach(interp,g_status->ring_name,g_status->ring_slots);
+            }
+        } else if (g_status->queue_size > 0) {
+            queue_start(g_status->queue_size);
+        }
+        SYSLOG_ATOMIC_STORE(g_status->opened,true);
     }
+    return result;
 }
 
+/*
+ * SyslogClose
+ *
+ * Stops the delivery machinery and closes the transport. The collector
+ * and the writer thread may be stuck sending to the daemon: syslogMutex
+ * is released while they're joined, so that a thread forking (the
+ * pthread_atfork handlers take syslogMutex) or logging its first
+ * message doesn't wait for them. SyslogOpen waits for the close
+ * in progress to complete
+ */
+
 static void SyslogClose(void)
 {
     if (g_status->opened) {
-        SYSLOG_DEBUG_MSG("Calling closelog")
-        closelog();
-        g_status->opened = false;
+        SYSLOG_DEBUG_MSG("Closing transport")
+        SYSLOG_ATOMIC_STORE(g_status->opened,false);
+        closing = true;
+        SYSLOG_MUTEX_UNLOCK
+        ring_detach();
+        queue_stop();
+        transport_close();
+        SYSLOG_MUTEX_LOCK
+        closing = false;
+        Tcl_ConditionNotify(&syslogClosed);
     }
+    msgcache_invalidate();
 }
 
-static inline void log_message (SyslogThreadStatus* status) {
+/*
+ * render_message
+ *
+ * Fills body with the segments of the message expanded in the
+ * thread format. A plain format (literal text and one '%s', see
+ * format.c) costs no copy: the literal text comes from the compiled
+ * format and the message is the middle segment of the record. Any
+ * other format is rendered in status->render taking the message as
+ * its only argument, the message is sent as it is when it doesn't
+ * fit the conversions. A message rendered by log_arguments with the
+ * arguments of the call is already formatted
+ *
+ * Returned value: the number of segments stored in body
+ */
+
+static int render_message (SyslogThreadStatus* status,struct iovec* body)
+{
+    const CompiledFormat*   compiled;
+    int                     nbody = 0;
+    int                     i;
+
+    if ((status->format == g_default_format) || status->is_formatted) {
+        body[0].iov_base = status->message;
+        body[0].iov_len  = status->message_len;
+        return 1;
+    }
+
+    compiled = format_compiled(status->format);
+    if (compiled->plain) {
+        for (i = 0; i < compiled->nsegments; i++) {
+            const FormatSegment* segment = &compiled->segments[i];
+
+            if (segment->type == FORMAT_LITERAL) {
+                body[nbody].iov_base = compiled->literals + segment->offset;
+                body[nbody].iov_len  = segment->length;
+            } else {
+                body[nbody].iov_base = status->message;
+                body[nbody].iov_len  = status->message_len;
+            }
+            nbody++;
+        }
+        return nbody;
+    }
+
+    Tcl_Obj* message = Tcl_NewStringObj(status->message,status->message_len);
+
+    Tcl_IncrRefCount(message);
+    if (format_render(NULL,compiled,&status->render,&message,1) == TCL_OK) {
+        body[0].iov_base = Tcl_DStringValue(&status->render);
+        body[0].iov_len  = Tcl_DStringLength(&status->render);
+    } else {
+        body[0].iov_base = status->message;
+        body[0].iov_len  = status->message_len;
+    }
+    Tcl_DecrRefCount(message);
+    return 1;
+}
+
+/*
+ * escape_message
+ *
+ * Escapes the control characters of the body segments according to
+ * the thread -escape mode. Segments are only scanned as long as they
+ * are clean: the first one needing an escape makes the whole body
+ * copied into status->escaped which becomes its only segment
+ *
+ * Returned value: the number of segments in body
+ */
+
+static int escape_message (SyslogThreadStatus* status,struct iovec* body,int nbody)
+{
+    int i;
+
+    for (i = 0; i < nbody; i++) {
+        if (escape_scan(body[i].iov_base,body[i].iov_len) < (int) body[i].iov_len) { break; }
+    }
+    if (i == nbody) { return nbody; }
+
+    Tcl_DStringSetLength(&status->escaped,0);
+    for (i = 0; i < nbody; i++) {
+        escape_append(&status->escaped,body[i].iov_base,body[i].iov_len,status->escape);
+    }
+    body[0].iov_base = Tcl_DStringValue(&status->escaped);
+    body[0].iov_len  = Tcl_DStringLength(&status->escaped);
+    return 1;
+}
+
+/*
+ * deliver
+ *
+ * Writes a record in the log ring when -ring is set or hands it to the
+ * writer thread when -queue is set. Otherwise (or when the ring is full
+ * or the queue is being stopped) sends it right away
+ *
+ * Returned value: TCL_OK or ERROR if the record couldn't be sent
+ */
+
+static int deliver (SyslogThreadStatus* status,int pri,struct iovec* body,int nbody)
+{
+    if (ring_attached() && ring_push(status,pri,body,nbody)) {
+        return TCL_OK;
+    }
+    if ((SYSLOG_ATOMIC_LOAD(g_status->queue_size) > 0) && queue_push(status,pri,body,nbody)) {
+        return TCL_OK;
+    }
+    return transport_send(status,pri,body,nbody);
+}
+
+/*
+ * chunk_length
+ *
+ * Length of the next chunk of text not exceeding capacity. The chunk is
+ * shortened so that it doesn't end in the middle of a UTF-8 sequence
+ */
+
+static int chunk_length (const char* text,int length,int capacity)
+{
+    int cut = capacity;
+
+    if (length <= capacity) {
+        return length;
+    }
+
+    /* text[cut] is the first byte of the next chunk, it must not be a continuation byte */
+
+    while ((cut > 0) && (((unsigned char) text[cut] & 0xC0) == 0x80)) {
+        cut--;
+    }
+    return (cut > 0) ? cut : capacity;
+}
+
+/*
+ * log_chunks
+ *
+ * Sends a message body longer than the -maxsize limit as a sequence
+ * of records sharing a message id. Every record is prefixed by the
+ * marker '[id i/n] '. The limit applies to the body, marker included:
+ * the record header (priority, timestamp, ident) isn't counted
+ */
+
+static int log_chunks (SyslogThreadStatus* status,int pri,struct iovec* body,int nbody,int length,int max_size)
+{
+    static unsigned long chunked_message_id = 0;
+
+    Tcl_DString     flat;
+    const char*     text;
+    struct iovec    chunk[2];
+    char            marker[CHUNK_MARKER_SIZE];
+    int             capacity = max_size - CHUNK_MARKER_SIZE;
+    unsigned long   message_id;
+    int             marker_len;
+    int             nchunks;
+    int             offset;
+    int             result = TCL_OK;
+    int             i;
+
+    Tcl_DStringInit(&flat);
+    if (nbody == 1) {
+        text = body[0].iov_base;
+    } else {
+        for (i = 0; i < nbody; i++) {
+            Tcl_DStringAppend(&flat,body[i].iov_base,body[i].iov_len);
+        }
+        text = Tcl_DStringValue(&flat);
+    }
+
+    for (nchunks = 0, offset = 0; offset < length; nchunks++) {
+        offset += chunk_length(text + offset,length - offset,capacity);
+    }
+
+    message_id = SYSLOG_ATOMIC_INCR(chunked_message_id);
+    for (i = 1, offset = 0; offset < length; i++) {
+        int chunk_len = chunk_length(text + offset,length - offset,capacity);
+
+        marker_len = snprintf(marker,sizeof(marker),"[%lx %d/%d] ",message_id,i,nchunks);
+        chunk[0].iov_base = marker;
+        chunk[0].iov_len  = (marker_len < (int) sizeof(marker)) ? marker_len : sizeof(marker) - 1;
+        chunk[1].iov_base = (char *) text + offset;
+        chunk[1].iov_len  = chunk_len;
+        if (deliver(status,pri,chunk,2) != TCL_OK) {
+            result = TCL_ERROR;
+        }
+        offset += chunk_len;
+    }
+    Tcl_DStringFree(&flat);
+    return result;
+}
+
+/*
+ * log_message
+ *
+ * Renders and sends the message in status. The caller already checked
+ * the level with threshold_enabled, every message is checked once and
+ * a discarded message is never prepared. This function is called
+ * without holding syslogMutex: the global status fields read here are
+ * loaded atomically, the transport works on its own copy of the
+ * settings and serializes on the lock of the connection shard the
+ * thread is bound to
+ *
+ * Returned value: TCL_OK or TCL_ERROR if the record (or one of its
+ * chunks) couldn't be sent
+ */
+
+int log_message (SyslogThreadStatus* status) {
+    struct iovec body[TRANSPORT_MAX_BODY_IOV];
+    int nbody;
+    int length = 0;
+    int max_size = SYSLOG_ATOMIC_LOAD(g_status->max_size);
+    int pri;
+    int i;
+    int result;
     int facility = status->facility;
     if (facility < 0) {
-        facility = g_status->facility;
+        facility = SYSLOG_ATOMIC_LOAD(g_status->facility);
+    }
+    pri = LOG_MAKEPRI(facility,status->level);
+    SYSLOG_PROBE3(message__entry,status->level,facility,status->message_len);
+
+    /* like syslog(3) does, the first message opens the connection */
+
+    if (!SYSLOG_ATOMIC_LOAD(g_status->opened)) {
+        SYSLOG_MUTEX_LOCK
+        SyslogOpen(NULL);
+        SYSLOG_MUTEX_UNLOCK
+    }
+
+    /* the context prefix is prepended as it is, it was rendered when pushed */
+
+    nbody = 0;
+    if ((status->message_obj != NULL) && msgcache_lookup(status,status->message_obj,body)) {
+        nbody = 1;
+    } else {
+        if ((Tcl_DStringLength(&status->context_prefix) > 0) && !status->is_structured) {
+            body[0].iov_base = Tcl_DStringValue(&status->context_prefix);
+            body[0].iov_len  = Tcl_DStringLength(&status->context_prefix);
+            nbody = 1;
+        }
+        nbody += render_message(status,body + nbody);
+        if (status->escape != ESCAPE_NONE) {
+            nbody = escape_message(status,body,nbody);
+        }
+        if (status->message_obj != NULL) {
+            msgcache_store(status,status->message_obj,body,nbody);
+        }
+    }
+    for (i = 0; i < nbody; i++) {
+        length += body[i].iov_len;
+    }
+    SYSLOG_PROBE3(message__formatted,status->level,facility,length);
+
+    if ((max_size > 0) && (length > max_size)) {
+        result = log_chunks(status,pri,body,nbody,length,max_size);
+    } else {
+        result = deliver(status,pri,body,nbody);
     }
-    syslog(LOG_MAKEPRI(facility,status->level),status->format,status->message);
 #ifdef TCL_SYSLOG_DEBUG
     (status->count)++;
 #endif
+    return result;
+}
+
+/*
+ * log_formatted
+ *
+ * Logs the arguments of ::syslog::log when the thread format has
+ * conversions other than a single '%s': they are 'level arg ?arg ...?'
+ * or 'arg ?arg ...?', one argument for each conversion. The message
+ * is rendered in status->render and sent with no further formatting
+ */
+
+static int log_formatted (Tcl_Interp* interp,ParseArgsOptions* pao,const CompiledFormat* compiled,
+                          int objc,Tcl_Obj *CONST86 objv[])
+{
+    SyslogThreadStatus* status = pao->status;
+    int first_arg = pao->last_option_index + 1;
+    int nargs = objc - first_arg;
+
+    if (nargs == compiled->nconversions + 1) {
+        int level_code = level_cli_to_code(interp,Tcl_GetString(objv[first_arg]));
+        if (level_code == ERROR) {
+            Tcl_SetObjResult(interp,Tcl_NewStringObj("Unknown level specified.",-1));
+            return TCL_ERROR;
+        }
+        status->level = level_code;
+        first_arg++;
+    } else if (nargs != compiled->nconversions) {
+        Tcl_SetObjResult(interp,Tcl_ObjPrintf("wrong # args: the format expects %d arguments",
+                                              compiled->nconversions));
+        return TCL_ERROR;
+    }
+
+    /* discarded messages are not formatted */
+
+    if (!threshold_enabled(status->level)) {
+        return TCL_OK;
+    }
+
+    if (format_render(interp,compiled,&status->render,objv + first_arg,compiled->nconversions) != TCL_OK) {
+        return TCL_ERROR;
+    }
+    status->message     = Tcl_DStringValue(&status->render);
+    status->message_len = Tcl_DStringLength(&status->render);
+
+    status->is_structured = (pao->json != NULL);
+    if (status->is_structured) {
+        if (json_encode(interp,&status->structured,status->context,pao->json,
+                        status->message,status->message_len,pao->cee) != TCL_OK) {
+            return TCL_ERROR;
+        }
+        status->message = Tcl_DStringValue(&status->structured);
+        status->message_len = Tcl_DStringLength(&status->structured);
+    }
+
+    status->is_formatted = true;
+    log_message(status);
+    status->is_formatted = false;
+    return TCL_OK;
+}
+
+/*
+ * log_arguments
+ *
+ * Logs the arguments following the options of ::syslog::log and syslog:
+ * either 'level message' or just 'message'. When a -json dictionary was
+ * passed the record is the JSON object encoded in status->structured
+ * with the message (if any) stored under the key 'msg'. The pairs of
+ * the thread context are members of the object rather than a prefix
+ */
+
+static int log_arguments (Tcl_Interp* interp,ParseArgsOptions* pao,int objc,Tcl_Obj *CONST86 objv[])
+{
+    SyslogThreadStatus* status = pao->status;
+    int first_non_opt_arg = pao->last_option_index + 1;
+    int nargs = objc - first_non_opt_arg;
+
+    if (status->format != g_default_format) {
+        const CompiledFormat* compiled = format_compiled(status->format);
+
+        if (!compiled->plain || (compiled->nconversions > 1)) {
+            return log_formatted(interp,pao,compiled,objc,objv);
+        }
+    }
+
+    if (nargs == 2) {
+        int level_code = level_cli_to_code(interp,Tcl_GetString(objv[objc-2]));
+        if (level_code == ERROR) {
+            Tcl_SetObjResult(interp,Tcl_NewStringObj("Unknown level specified.",-1));
+            return TCL_ERROR;
+        }
+        status->level = level_code;
+    }
+
+    /* discarded messages are neither formatted nor encoded */
+
+    if (!threshold_enabled(status->level)) {
+        return TCL_OK;
+    }
+
+    if ((nargs == 1) || (nargs == 2)) {
+        status->message = Tcl_GetStringFromObj(objv[objc-1],&status->message_len);
+    } else if ((nargs == 0) && (pao->json != NULL)) {
+        status->message = NULL;
+        status->message_len = 0;
+    } else {
+        return TCL_OK;
+    }
+
+    status->is_structured = (pao->json != NULL);
+    if (status->is_structured) {
+        if (json_encode(interp,&status->structured,status->context,pao->json,
+                        status->message,status->message_len,pao->cee) != TCL_OK) {
+            return TCL_ERROR;
+        }
+        status->message = Tcl_DStringValue(&status->structured);
+        status->message_len = Tcl_DStringLength(&status->structured);
+    } else {
+        status->message_obj = objv[objc-1];
+    }
+    log_message(status);
+    status->message_obj = NULL;
+    return TCL_OK;
 }
 
 static int SyslogLogmaskCmd (ClientData clientData,
@@ -238,9 +807,9 @@ static int SyslogOpenCmd (ClientData clientData,
     int tcl_exit_status = TCL_OK;
     ParseArgsOptions pao;
 
-    init_parse_options(&pao);
+    init_parse_options(&pao,(SyslogThreadStatus *) clientData);
     pao.facility_is_private = false;
-    pao.option_class = GLOBAL_OPTION_CLASS;
+    pao.option_class = GLOBAL_OPTION_CLASS | RUNTIME_OPTION_CLASS;
 
     SYSLOG_MUTEX_LOCK
     int parse_result = parse_options (interp,objc,objv,&pao);
@@ -265,11 +834,11 @@ static int SyslogOpenCmd (ClientData clientData,
 
             if (pao.last_option_index != objc-1) {
                 Tcl_WrongNumArgs(interp,objc,objv,
-                    "open ?-ident ident? ?-facility facility? ?-pid? ?-perror? ?-nodelay? ?-console?");
+                    "open ?-ident ident? ?-socket path? ?-connections n? ?-queue n? ?-maxsize bytes? ?-sndbuf bytes? ?-sendtimeout ms? ?-ring name? ?-ringslots n? ?-facility facility? ?-pid? ?-perror? ?-nodelay? ?-nonblocking ?boolean?? ?-console?");
                 tcl_exit_status = TCL_ERROR;
             } else {
                 SyslogClose();
-                SyslogOpen();
+                tcl_exit_status = SyslogOpen(interp);
             }
         }
     }
@@ -293,7 +862,8 @@ static int SyslogConfigureCmd (ClientData clientData,
                                     Tcl_Interp *interp,
                                     int objc,Tcl_Obj *CONST86 objv[]) {
     ParseArgsOptions pao;
-    init_parse_options(&pao);
+    init_parse_options(&pao,(SyslogThreadStatus *) clientData);
+    pao.option_class = GLOBAL_OPTION_CLASS | RUNTIME_OPTION_CLASS | PER_THREAD_OPTION_CLASS;
 
     int tcl_exit_status = TCL_OK;   
     SYSLOG_MUTEX_LOCK
@@ -306,8 +876,9 @@ static int SyslogConfigureCmd (ClientData clientData,
         tcl_exit_status = TCL_ERROR;
     } else if (pao.modified_opt_class & GLOBAL_OPTION_CLASS) {
         SyslogClose();
-        SyslogOpen();
+        tcl_exit_status = SyslogOpen(interp);
     }
+    msgcache_invalidate();
 
     SYSLOG_MUTEX_UNLOCK
     return tcl_exit_status;
@@ -329,6 +900,49 @@ static int SyslogCGetCmd (ClientData clientData,
                 Tcl_ListObjAppendElement(interp,global_conf,Tcl_NewStringObj("-ident",-1));
                 Tcl_ListObjAppendElement(interp,global_conf,Tcl_NewStringObj(g_status->ident,-1));
             }
+            if (g_status->socket_path != NULL) {
+                Tcl_ListObjAppendElement(interp,global_conf,Tcl_NewStringObj("-socket",-1));
+                Tcl_ListObjAppendElement(interp,global_conf,Tcl_NewStringObj(g_status->socket_path,-1));
+            }
+            if (g_status->connections > 1) {
+                Tcl_ListObjAppendElement(interp,global_conf,Tcl_NewStringObj("-connections",-1));
+                Tcl_ListObjAppendElement(interp,global_conf,Tcl_NewIntObj(g_status->connections));
+            }
+            if (g_status->queue_size > 0) {
+                Tcl_ListObjAppendElement(interp,global_conf,Tcl_NewStringObj("-queue",-1));
+                Tcl_ListObjAppendElement(interp,global_conf,Tcl_NewIntObj(g_status->queue_size));
+            }
+            if (g_status->ring_name != NULL) {
+                Tcl_ListObjAppendElement(interp,global_conf,Tcl_NewStringObj("-ring",-1));
+                Tcl_ListObjAppendElement(interp,global_conf,Tcl_NewStringObj(g_status->ring_name,-1));
+                Tcl_ListObjAppendElement(interp,global_conf,Tcl_NewStringObj("-ringslots",-1));
+                Tcl_ListObjAppendElement(interp,global_conf,Tcl_NewIntObj(g_status->ring_slots));
+            }
+            if (g_status->sndbuf > 0) {
+                Tcl_ListObjAppendElement(interp,global_conf,Tcl_NewStringObj("-sndbuf",-1));
+                Tcl_ListObjAppendElement(interp,global_conf,Tcl_NewIntObj(g_status->sndbuf));
+            }
+            if (g_status->send_timeout > 0) {
+                Tcl_ListObjAppendElement(interp,global_conf,Tcl_NewStringObj("-sendtimeout",-1));
+                Tcl_ListObjAppendElement(interp,global_conf,Tcl_NewIntObj(g_status->send_timeout));
+            }
+            if (threshold_base() != LOG_DEBUG) {
+                Tcl_ListObjAppendElement(interp,global_conf,Tcl_NewStringObj("-threshold",-1));
+                Tcl_ListObjAppendElement(interp,global_conf,Tcl_NewStringObj(level_code_to_cli(threshold_base()),-1));
+            }
+            if (strcmp(threshold_signal(),"none") != 0) {
+                Tcl_ListObjAppendElement(interp,global_conf,Tcl_NewStringObj("-levelsignal",-1));
+                Tcl_ListObjAppendElement(interp,global_conf,Tcl_NewStringObj(threshold_signal(),-1));
+            }
+            Tcl_Obj* level_file = threshold_file();
+            if (level_file != NULL) {
+                Tcl_ListObjAppendElement(interp,global_conf,Tcl_NewStringObj("-levelfile",-1));
+                Tcl_ListObjAppendElement(interp,global_conf,level_file);
+            }
+            if (g_status->max_size > 0) {
+                Tcl_ListObjAppendElement(interp,global_conf,Tcl_NewStringObj("-maxsize",-1));
+                Tcl_ListObjAppendElement(interp,global_conf,Tcl_NewIntObj(g_status->max_size));
+            }
 
             char* facility = facility_code_to_cli(g_status->facility);
             if (facility != NULL) {
@@ -356,7 +970,7 @@ static int SyslogCGetCmd (ClientData clientData,
         }
     }
 
-    SyslogThreadStatus *status = (SyslogThreadStatus *) Tcl_GetThreadData(&syslogKey, sizeof(SyslogThreadStatus));
+    SyslogThreadStatus *status = (SyslogThreadStatus *) clientData;
     Tcl_Obj* configuration = Tcl_NewObj();
     Tcl_IncrRefCount(configuration);
 
@@ -364,6 +978,8 @@ static int SyslogCGetCmd (ClientData clientData,
     Tcl_ListObjAppendElement(interp,configuration,Tcl_NewStringObj(status->format,-1));
     Tcl_ListObjAppendElement(interp,configuration,Tcl_NewStringObj("-level",-1));
     Tcl_ListObjAppendElement(interp,configuration,Tcl_NewStringObj(level_code_to_cli(status->level),-1));
+    Tcl_ListObjAppendElement(interp,configuration,Tcl_NewStringObj("-escape",-1));
+    Tcl_ListObjAppendElement(interp,configuration,Tcl_NewStringObj(escape_modes[status->escape],-1));
     if (status->facility >= 0) {
         Tcl_ListObjAppendElement(interp,configuration,Tcl_NewStringObj("-facility",-1));
         Tcl_ListObjAppendElement(interp,configuration,Tcl_NewStringObj(facility_code_to_cli(status->facility),-1));
@@ -378,7 +994,7 @@ static int SyslogCGetCmd (ClientData clientData,
 static int SyslogCmd (ClientData clientData,Tcl_Interp *interp,int objc,Tcl_Obj *CONST86 objv[]) {
     ParseArgsOptions pao;
 
-    init_parse_options(&pao);
+    init_parse_options(&pao,(SyslogThreadStatus *) clientData);
 
     /*  
      *  having less than 2 arguments to 'syslog' is wrong 
@@ -412,31 +1028,17 @@ static int SyslogCmd (ClientData clientData,Tcl_Interp *interp,int objc,Tcl_Obj
     } else if (pao.unhandled_opt_index) {
         wrong_command_option(interp,objc,objv,pao.unhandled_opt_index);
         tcl_exit_code = TCL_ERROR;
-    } else {
-        if (pao.modified_opt_class & GLOBAL_OPTION_CLASS) {
-            SyslogClose();
-            SyslogOpen();
-        } 
-
-        int first_non_opt_arg = pao.last_option_index + 1;
-        if (first_non_opt_arg == objc-2) {
-            Tcl_Obj* level_o = objv[objc-2];
-
-            int level_code = level_cli_to_code(interp,Tcl_GetString(level_o));
-            if (level_code == ERROR) {
-                Tcl_SetObjResult(interp,Tcl_NewStringObj("Unknown level specified.",-1));
-                tcl_exit_code = TCL_ERROR;
-            }
-            pao.status->level = level_code;
-            pao.status->message = Tcl_GetString(objv[objc-1]);
-            log_message(pao.status);
-        } else if (first_non_opt_arg == objc-1) {
-            pao.status->message = Tcl_GetString(objv[objc-1]);
-            log_message(pao.status);
-        }
+    } else if (pao.modified_opt_class & GLOBAL_OPTION_CLASS) {
+        SyslogClose();
+        tcl_exit_code = SyslogOpen(interp);
     }
-
     SYSLOG_MUTEX_UNLOCK
+
+    /* the message is sent out of the global lock, see log_message */
+
+    if (tcl_exit_code == TCL_OK) {
+        tcl_exit_code = log_arguments(interp,&pao,objc,objv);
+    }
     return tcl_exit_code;
 }
 
@@ -445,7 +1047,7 @@ static int SyslogLogCmd (ClientData clientData,
                           int objc,Tcl_Obj *CONST86 objv[]) {
     ParseArgsOptions pao;
 
-    init_parse_options(&pao);
+    init_parse_options(&pao,(SyslogThreadStatus *) clientData);
 
     /* We repeat what we do in SyslogCmd but 
      * skip the processing of the open specific
@@ -458,7 +1060,7 @@ static int SyslogLogCmd (ClientData clientData,
         return TCL_ERROR;
     }
 
-    pao.option_class  = PER_THREAD_OPTION_CLASS;
+    pao.option_class  = PER_THREAD_OPTION_CLASS | PER_CALL_OPTION_CLASS;
     int parse_result = parse_options(interp,objc, objv, &pao);
     if (parse_result == ERROR) {
         return TCL_ERROR;
@@ -470,24 +1072,175 @@ static int SyslogLogCmd (ClientData clientData,
         return TCL_ERROR;
     }
 
-    int first_non_opt_arg = pao.last_option_index + 1;
-    SYSLOG_MUTEX_LOCK
-    if (first_non_opt_arg == objc-2) {
-        Tcl_Obj* level_o = objv[objc-2];
+    return log_arguments(interp,&pao,objc,objv);
+}
 
-        int level_code = level_cli_to_code(interp,Tcl_GetString(level_o));
-        if (level_code == ERROR) {
-            Tcl_SetObjResult(interp,Tcl_NewStringObj("Unknown level specified.",-1));
-            return TCL_ERROR;
+/*
+ * render_context
+ *
+ * Renders the pairs of the context dictionaries in status->context_prefix
+ * as 'key=value ' sequences. Values that are empty or have spaces, quotes
+ * or '=' in them are quoted (logfmt style)
+ */
+
+static void render_context (SyslogThreadStatus* status)
+{
+    Tcl_DString*    prefix = &status->context_prefix;
+    int             ncontext = 0;
+    int             i;
+
+    Tcl_DStringSetLength(prefix,0);
+    status->generation = msgcache_thread_generation();
+    if (status->context == NULL) { return; }
+
+    Tcl_ListObjLength(NULL,status->context,&ncontext);
+    for (i = 0; i < ncontext; i++) {
+        Tcl_Obj*        pairs;
+        Tcl_DictSearch  search;
+        Tcl_Obj*        key;
+        Tcl_Obj*        value;
+        int             done;
+
+        Tcl_ListObjIndex(NULL,status->context,i,&pairs);
+        Tcl_DictObjFirst(NULL,pairs,&search,&key,&value,&done);
+        for (; !done; Tcl_DictObjNext(&search,&key,&value,&done)) {
+            int         value_len;
+            const char* value_s = Tcl_GetStringFromObj(value,&value_len);
+
+            Tcl_DStringAppend(prefix,Tcl_GetString(key),-1);
+            Tcl_DStringAppend(prefix,"=",1);
+            if ((value_len == 0) || (strpbrk(value_s," \"=") != NULL)) {
+                const char* v;
+
+                Tcl_DStringAppend(prefix,"\"",1);
+                for (v = value_s; *v != '\0'; v++) {
+                    if ((*v == '"') || (*v == '\\')) { Tcl_DStringAppend(prefix,"\\",1); }
+                    Tcl_DStringAppend(prefix,v,1);
+                }
+                Tcl_DStringAppend(prefix,"\"",1);
+            } else {
+                Tcl_DStringAppend(prefix,value_s,value_len);
+            }
+            Tcl_DStringAppend(prefix," ",1);
+        }
+        Tcl_DictObjDone(&search);
+    }
+}
+
+/*
+ * SyslogContextCmd
+ *
+ *  ::syslog::context push dictionary
+ *  ::syslog::context pop
+ *  ::syslog::context get
+ *  ::syslog::context clear
+ *
+ * Manages the stack of key-value pairs prepended to every message
+ * logged by the interpreter. The prefix is rendered only when the stack
+ * changes. 'get' returns the list of the dictionaries on the stack
+ */
+
+static int SyslogContextCmd (ClientData clientData,
+                             Tcl_Interp *interp,
+                             int objc,Tcl_Obj *CONST86 objv[]) {
+    static const char* subcommands[] = { "push", "pop", "get", "clear", NULL };
+    enum { CONTEXT_PUSH, CONTEXT_POP, CONTEXT_GET, CONTEXT_CLEAR };
+
+    SyslogThreadStatus* status = (SyslogThreadStatus *) clientData;
+    int                 subcommand;
+    int                 depth = 0;
+
+    if (objc < 2) {
+        Tcl_WrongNumArgs(interp,1,objv,"push dictionary|pop|get|clear");
+        return TCL_ERROR;
+    }
+    if (Tcl_GetIndexFromObj(interp,objv[1],subcommands,"subcommand",0,&subcommand) != TCL_OK) {
+        return TCL_ERROR;
+    }
+    if (((subcommand == CONTEXT_PUSH) && (objc != 3)) || ((subcommand != CONTEXT_PUSH) && (objc != 2))) {
+        Tcl_WrongNumArgs(interp,2,objv,(subcommand == CONTEXT_PUSH) ? "dictionary" : NULL);
+        return TCL_ERROR;
+    }
+
+    if (status->context == NULL) {
+        status->context = Tcl_NewListObj(0,NULL);
+        Tcl_IncrRefCount(status->context);
+    }
+    Tcl_ListObjLength(NULL,status->context,&depth);
+
+    switch (subcommand) {
+        case CONTEXT_PUSH:
+        {
+            int size;
+
+            /* the stack is iterated without an interpreter reporting errors */
+
+            if (Tcl_DictObjSize(interp,objv[2],&size) != TCL_OK) {
+                return TCL_ERROR;
+            }
+            if (Tcl_IsShared(status->context)) {
+                Tcl_DecrRefCount(status->context);
+                status->context = Tcl_DuplicateObj(status->context);
+                Tcl_IncrRefCount(status->context);
+            }
+            Tcl_ListObjAppendElement(NULL,status->context,objv[2]);
+            render_context(status);
+            break;
+        }
+        case CONTEXT_POP:
+        {
+            if (depth == 0) {
+                Tcl_SetObjResult(interp,Tcl_NewStringObj("context stack is empty",-1));
+                return TCL_ERROR;
+            }
+            if (Tcl_IsShared(status->context)) {
+                Tcl_DecrRefCount(status->context);
+                status->context = Tcl_DuplicateObj(status->context);
+                Tcl_IncrRefCount(status->context);
+            }
+            Tcl_ListObjReplace(NULL,status->context,depth-1,1,0,NULL);
+            render_context(status);
+            break;
+        }
+        case CONTEXT_GET:
+        {
+            Tcl_SetObjResult(interp,status->context);
+            break;
+        }
+        case CONTEXT_CLEAR:
+        {
+            Tcl_DecrRefCount(status->context);
+            status->context = NULL;
+            render_context(status);
+            break;
         }
-        pao.status->level = level_code;
-        pao.status->message = Tcl_GetString(objv[objc-1]);
-        log_message(pao.status);
-    } else if (first_non_opt_arg == objc-1) {
-        pao.status->message = Tcl_GetString(objv[objc-1]);
-        log_message(pao.status);
     }
-    SYSLOG_MUTEX_UNLOCK
     return TCL_OK;
 }
 
+/*
+ * SyslogStatsCmd
+ *
+ *  ::syslog::stats
+ *
+ * Returns the delivery statistics, see queue_stats and ring_stats
+ */
+
+static int SyslogStatsCmd (ClientData clientData,
+                           Tcl_Interp *interp,
+                           int objc,Tcl_Obj *CONST86 objv[]) {
+    if (objc != 1) {
+        Tcl_WrongNumArgs(interp,1,objv,NULL);
+        return TCL_ERROR;
+    }
+    Tcl_Obj* stats = queue_stats();
+
+    if (ring_attached()) {
+        Tcl_DictObjPut(NULL,stats,Tcl_NewStringObj("ring",-1),ring_stats());
+    }
+    Tcl_DictObjPut(NULL,stats,Tcl_NewStringObj("dropped",-1),Tcl_NewWideIntObj(transport_dropped()));
+    Tcl_DictObjPut(NULL,stats,Tcl_NewStringObj("interned",-1),Tcl_NewIntObj(intern_count()));
+    Tcl_DictObjPut(NULL,stats,Tcl_NewStringObj("threshold",-1),Tcl_NewStringObj(level_code_to_cli(threshold_level()),-1));
+    Tcl_SetObjResult(interp,stats);
+    return TCL_OK;
+}
@@ -22,7 +22,10 @@
 #ifndef __syslog_h__
 #define __syslog_h__
 
+#include <time.h>
+#include <sys/uio.h>
 #include <tcl.h>
+#include "probes.h"
 
 /* Definition suggested in
  *
@@ -53,13 +56,32 @@ typedef bool _Bool;
 #define SYSLOG_DEBUG_MSG(s)
 #endif
 
+/*
+ * Logging settings and buffers of an interpreter (its assoc data), of a
+ * thread using the C interface, of a channel or a Syslog_Logger
+ */
+
 typedef struct SyslogThreadStatus {
-    char*   format;
+    const char* format;     /* interned, see intern.c */
     int     level;
     int     facility;
     bool    initialized;
     int     open_changed;
     char*   message;        /* volatile string pointer */
+    int     message_len;
+    Tcl_Obj* message_obj;   /* object of the message when its body can be cached */
+    unsigned int generation; /* of the bodies cached by the thread, see msgcache.c */
+    time_t  timestamp_sec;  /* second the cached header timestamp refers to */
+    char    timestamp[32];
+    Tcl_DString render;     /* message rendered with a custom format */
+    Tcl_DString structured; /* JSON encoding of the -json dictionary */
+    bool    is_structured;  /* the message is the JSON object in structured */
+    bool    is_formatted;   /* the message was already rendered with the format */
+    Tcl_Obj* context;       /* list of the dictionaries pushed with ::syslog::context */
+    Tcl_DString context_prefix; /* the context rendered as 'key=value ...' */
+    int     escape;         /* escaping of control characters (ESCAPE_*) */
+    Tcl_DString escaped;    /* message body with the control characters escaped */
+    unsigned int shard_hash; /* selects the transport connection of the thread */
 #ifdef TCL_SYSLOG_DEBUG
     uint32_t magic;
     int     count;
@@ -67,7 +89,15 @@ typedef struct SyslogThreadStatus {
 } SyslogThreadStatus;
 
 typedef struct SyslogGlobalStatus {
-    char*   ident;
+    const char* ident;      /* interned, see intern.c */
+    char*   socket_path;    /* NULL means the system default (/dev/log) */
+    int     max_size;       /* messages longer than this are split, 0: no limit */
+    int     connections;    /* number of transport shards */
+    int     queue_size;     /* records the bulk lane can hold, 0: synchronous delivery */
+    int     sndbuf;         /* SO_SNDBUF of the transport sockets, 0: system default */
+    int     send_timeout;   /* milliseconds a -nonblocking send may wait */
+    char*   ring_name;      /* shared memory log ring (-ring), NULL: none */
+    int     ring_slots;
     int     facility;
     int     options;
     bool    opened;
@@ -76,7 +106,9 @@ typedef struct SyslogGlobalStatus {
 #define    UNDEFINED_OPTION_CLASS   (int)0
 #define    GLOBAL_OPTION_CLASS      (int)1
 #define    PER_THREAD_OPTION_CLASS  (int)2
-#define    ALL_OPTION_CLASSES       (int)3
+#define    PER_CALL_OPTION_CLASS    (int)4
+#define    RUNTIME_OPTION_CLASS     (int)8      /* global, applied without reopening */
+#define    ALL_OPTION_CLASSES       (int)15
 
 typedef int OptionClass;
 
@@ -87,21 +119,38 @@ typedef struct _ParseArgsOptions {
     OptionClass         option_class;
     OptionClass         modified_opt_class;
     bool                facility_is_private;
+    Tcl_Obj*            json;       /* -json dictionary of the current call */
+    bool                cee;
 } ParseArgsOptions;
 
 #ifdef TCL_THREADS
 
-#define SYSLOG_MUTEX_LOCK   Tcl_MutexLock(&syslogMutex);
-#define SYSLOG_MUTEX_UNLOCK Tcl_MutexUnlock(&syslogMutex);
+#define SYSLOG_MUTEX_LOCK   SYSLOG_PROBE0(mutex__acquire); \
+                            Tcl_MutexLock(&syslogMutex); \
+                            SYSLOG_PROBE0(mutex__acquired);
+#define SYSLOG_MUTEX_UNLOCK Tcl_MutexUnlock(&syslogMutex); \
+                            SYSLOG_PROBE0(mutex__release);
 #define SYSLOG_ATOMIC_ASSIGN(varname,sourcename) \
         Tcl_MutexLock(&syslogMutex); \
         varname = sourcename; \
         Tcl_MutexUnlock(&syslogMutex);
+#define SYSLOG_ATOMIC_INCR(varname) __atomic_add_fetch(&(varname),1,__ATOMIC_RELAXED)
+#define SYSLOG_ATOMIC_ADD(varname,n) __atomic_add_fetch(&(varname),(n),__ATOMIC_RELAXED)
+#define SYSLOG_ATOMIC_LOAD(varname) __atomic_load_n(&(varname),__ATOMIC_RELAXED)
+#define SYSLOG_ATOMIC_STORE(varname,value) __atomic_store_n(&(varname),(value),__ATOMIC_RELAXED)
+#define SYSLOG_ATOMIC_CAS(varname,expected,desired) \
+        __atomic_compare_exchange_n(&(varname),&(expected),(desired),false,__ATOMIC_RELAXED,__ATOMIC_RELAXED)
 #else
 
 #define SYSLOG_MUTEX_LOCK   
 #define SYSLOG_MUTEX_UNLOCK
 #define SYSLOG_ATOMIC_ASSIGN(varname,sourcename) varname = sourcename;
+#define SYSLOG_ATOMIC_INCR(varname) (++(varname))
+#define SYSLOG_ATOMIC_ADD(varname,n) ((varname) += (n))
+#define SYSLOG_ATOMIC_LOAD(varname) (varname)
+#define SYSLOG_ATOMIC_STORE(varname,value) ((varname) = (value))
+#define SYSLOG_ATOMIC_CAS(varname,expected,desired) \
+        (((varname) == (expected)) ? ((varname) = (desired), true) : false)
 
 #endif
 
@@ -111,8 +160,87 @@ typedef struct _ParseArgsOptions {
 
 #define SYSLOG_NS   "::syslog"
 
+/* key of the interpreter status in the assoc data */
+
+#define SYSLOG_ASSOC_KEY    "syslog"
+
+/* -escape modes */
+
+#define ESCAPE_NONE         0
+#define ESCAPE_OCTAL        1
+#define ESCAPE_JSON         2
+
+/*
+ * room reserved in every chunk for the '[id i/n] ' marker, the longest
+ * one with a 64 bit id and its terminating NUL: '[' 16 hex digits ' '
+ * 10 digits '/' 10 digits '] '
+ */
+
+#define CHUNK_MARKER_SIZE   48
+#define MIN_MAX_SIZE        (CHUNK_MARKER_SIZE + 16)
+
+/* longest record body cached in a message object */
+
+#define MSGCACHE_MAX_LENGTH 1024
+
 int parse_options(Tcl_Interp *interp, int objc, Tcl_Obj *CONST86 objv[],ParseArgsOptions* pao);
 
+/* message status handling and delivery */
+
+void    SyslogInitStatus (SyslogThreadStatus *status);
+void    SyslogFinalizeStatus (ClientData clientData);
+SyslogThreadStatus* get_thread_status (void);
+int     log_message (SyslogThreadStatus* status);
+
+/* level threshold */
+
+int         threshold_level (void);
+bool        threshold_enabled (int level);
+void        threshold_set (int level);
+int         threshold_base (void);
+int         threshold_set_signal (Tcl_Interp* interp,Tcl_Obj* signal_o);
+const char* threshold_signal (void);
+void        threshold_set_file (const char* path);
+Tcl_Obj*    threshold_file (void);
+void        threshold_fork_prepare (void);
+void        threshold_fork_release (void);
+
+/* interned strings */
+
+const char* intern_acquire (const char* text);
+const char* intern_acquire_format (const char* text);
+void*       intern_data (const char* text);
+void        intern_release (const char* text);
+unsigned int intern_serial (const char* text);
+int         intern_count (void);
+void        intern_fork_prepare (void);
+void        intern_fork_release (void);
+
+/* record bodies cached in the message objects */
+
+void            msgcache_invalidate (void);
+unsigned int    msgcache_thread_generation (void);
+bool            msgcache_lookup (SyslogThreadStatus* status,Tcl_Obj* obj,struct iovec* body);
+void            msgcache_store (SyslogThreadStatus* status,Tcl_Obj* obj,const struct iovec* body,int nbody);
+
+/* structured messages */
+
+int     json_encode (Tcl_Interp* interp,Tcl_DString* out,Tcl_Obj* context,Tcl_Obj* dictionary,
+                     const char* message,int message_len,bool cee);
+
+/* control characters escaping */
+
+int     escape_scan (const char* text,int length);
+void    escape_append (Tcl_DString* out,const char* text,int length,int mode);
+
+/* channel driver */
+
+int     SyslogChannelCmd (ClientData clientData, Tcl_Interp *interp, int objc, Tcl_Obj *CONST86 objv[]);
+
+/* native benchmark */
+
+int     SyslogBenchCmd (ClientData clientData, Tcl_Interp *interp, int objc, Tcl_Obj *CONST86 objv[]);
+
 /* facilities */
 
 int     facility_cli_to_code (Tcl_Interp *interp, const char *facility);
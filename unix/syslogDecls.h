@@ -0,0 +1,78 @@
+/*
+ * This file is (mostly) automatically generated from syslog.decls.
+ */
+
+#ifndef _SYSLOGDECLS
+#define _SYSLOGDECLS
+
+#ifndef SYSLOGAPI
+#   ifdef BUILD_syslog
+#	define SYSLOGAPI extern DLLEXPORT
+#   else
+#	define SYSLOGAPI extern DLLIMPORT
+#   endif
+#endif
+
+/* !BEGIN!: Do not edit below this line. */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Exported function declarations:
+ */
+
+/* 0 */
+SYSLOGAPI int		Syslog_Log(int level, int facility,
+				const char *message, size_t length);
+/* 1 */
+SYSLOGAPI int		Syslog_Enabled(int level);
+/* 2 */
+SYSLOGAPI Syslog_Logger * Syslog_LoggerCreate(int facility,
+				const char *format);
+/* 3 */
+SYSLOGAPI int		Syslog_LoggerLog(Syslog_Logger *logger, int level,
+				const char *message, size_t length);
+/* 4 */
+SYSLOGAPI void		Syslog_LoggerDelete(Syslog_Logger *logger);
+
+typedef struct SyslogStubs {
+    int magic;
+    void *hooks;
+
+    int (*syslog_Log) (int level, int facility, const char *message, size_t length); /* 0 */
+    int (*syslog_Enabled) (int level); /* 1 */
+    Syslog_Logger * (*syslog_LoggerCreate) (int facility, const char *format); /* 2 */
+    int (*syslog_LoggerLog) (Syslog_Logger *logger, int level, const char *message, size_t length); /* 3 */
+    void (*syslog_LoggerDelete) (Syslog_Logger *logger); /* 4 */
+} SyslogStubs;
+
+extern const SyslogStubs *syslogStubsPtr;
+
+#ifdef __cplusplus
+}
+#endif
+
+#if defined(USE_SYSLOG_STUBS)
+
+/*
+ * Inline function declarations:
+ */
+
+#define Syslog_Log \
+	(syslogStubsPtr->syslog_Log) /* 0 */
+#define Syslog_Enabled \
+	(syslogStubsPtr->syslog_Enabled) /* 1 */
+#define Syslog_LoggerCreate \
+	(syslogStubsPtr->syslog_LoggerCreate) /* 2 */
+#define Syslog_LoggerLog \
+	(syslogStubsPtr->syslog_LoggerLog) /* 3 */
+#define Syslog_LoggerDelete \
+	(syslogStubsPtr->syslog_LoggerDelete) /* 4 */
+
+#endif /* defined(USE_SYSLOG_STUBS) */
+
+/* !END!: Do not edit above this line. */
+
+#endif /* _SYSLOGDECLS */
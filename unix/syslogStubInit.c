@@ -0,0 +1,23 @@
+/*
+ * This file is (mostly) automatically generated from syslog.decls.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "tclSyslog.h"
+
+/* !BEGIN!: Do not edit below this line. */
+
+const SyslogStubs syslogStubs = {
+    TCL_STUB_MAGIC,
+    0,
+    Syslog_Log, /* 0 */
+    Syslog_Enabled, /* 1 */
+    Syslog_LoggerCreate, /* 2 */
+    Syslog_LoggerLog, /* 3 */
+    Syslog_LoggerDelete, /* 4 */
+};
+
+/* !END!: Do not edit above this line. */
@@ -0,0 +1,57 @@
+/*
+ *    syslogStubLib.c - stub library of the syslog package
+ *
+ *    A Tcl interface to the POSIX syslog service.
+ *
+ *    Copyright (C) 2026 Massimo Manghi <mxmanghi@apache.org>
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef USE_TCL_STUBS
+#define USE_TCL_STUBS
+#endif
+#undef  USE_SYSLOG_STUBS
+#define USE_SYSLOG_STUBS
+
+#include "tclSyslog.h"
+
+const SyslogStubs* syslogStubsPtr = NULL;
+
+/*
+ * Syslog_InitStubs
+ *
+ * Loads the syslog package and fills syslogStubsPtr with its stubs
+ * table. Called by an extension using the C interface of syslog
+ *
+ * Returned value: the version of the package or NULL (the message
+ * is left in interp)
+ */
+
+const char* Syslog_InitStubs (Tcl_Interp* interp,const char* version,int exact)
+{
+    const char*         actual_version;
+    const SyslogStubs*  stubs = NULL;
+
+    actual_version = Tcl_PkgRequireEx(interp,"syslog",version,exact,(void *) &stubs);
+    if (actual_version == NULL) {
+        return NULL;
+    }
+    if ((stubs == NULL) || (stubs->magic != TCL_STUB_MAGIC)) {
+        Tcl_SetObjResult(interp,Tcl_NewStringObj("the syslog package doesn't provide a stubs table",-1));
+        return NULL;
+    }
+    syslogStubsPtr = stubs;
+    return actual_version;
+}
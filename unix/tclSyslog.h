@@ -0,0 +1,70 @@
+/*
+ *    tclSyslog.h - public C interface of the syslog package
+ *
+ *    A Tcl interface to the POSIX syslog service.
+ *
+ *    Copyright (C) 2026 Massimo Manghi <mxmanghi@apache.org>
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Extensions loaded in the same process log through the connection,
+ * threshold and queues configured with ::syslog::open and
+ * ::syslog::configure calling these functions, no Tcl command is
+ * evaluated. An extension built with -DUSE_SYSLOG_STUBS links the stub
+ * library (libsyslogstub) and calls Syslog_InitStubs from its own
+ * initialization function, after Tcl_InitStubs:
+ *
+ *      if (Syslog_InitStubs(interp,"2.0",0) == NULL) {
+ *          return TCL_ERROR;
+ *      }
+ *      ...
+ *      if (Syslog_Enabled(LOG_DEBUG)) {
+ *          Syslog_Log(LOG_DEBUG,-1,message,length);
+ *      }
+ *
+ * Levels and facilities are the LOG_* codes of <syslog.h>, a facility
+ * < 0 stands for the facility set with ::syslog::open
+ */
+
+#ifndef __tcl_syslog_h__
+#define __tcl_syslog_h__
+
+#ifdef USE_SYSLOG_STUBS
+#ifndef USE_TCL_STUBS
+#define USE_TCL_STUBS
+#endif
+#endif
+
+#include <stddef.h>
+#include <tcl.h>
+
+/*
+ * A logger has its own facility and format and is independent of the
+ * settings of the thread calling it. A logger must not be used by two
+ * threads at the same time
+ */
+
+typedef struct Syslog_Logger Syslog_Logger;
+
+#include "syslogDecls.h"
+
+#ifdef USE_SYSLOG_STUBS
+const char* Syslog_InitStubs (Tcl_Interp* interp,const char* version,int exact);
+#else
+#define Syslog_InitStubs(interp,version,exact) Tcl_PkgRequire(interp,"syslog",version,exact)
+#endif
+
+#endif /* __tcl_syslog_h__ */
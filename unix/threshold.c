@@ -0,0 +1,289 @@
+/*
+ *    threshold.c - process-wide level threshold switched at runtime
+ *
+ *    A Tcl interface to the POSIX syslog service.
+ *
+ *    Copyright (C) 2026 Massimo Manghi <mxmanghi@apache.org>
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Messages less severe than the threshold are discarded before being
+ * formatted. The threshold is an int read by every thread with an atomic
+ * load and no lock. It's set by -threshold and can be changed while the
+ * process runs:
+ *
+ *  - by a signal (-levelsignal): every signal makes the threshold one
+ *    level more verbose, past 'debug' it goes back to the -threshold level
+ *  - by a control file (-levelfile) containing a level name. The log path
+ *    checks the file at most once per second, removing the file restores
+ *    the -threshold level. The file is read again when its modification
+ *    time (with nanoseconds where struct stat has st_mtim), size or inode
+ *    changed: a file rewritten within the same second is not missed
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <ctype.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <syslog.h>
+#include <time.h>
+#include <sys/stat.h>
+
+#include "syslog.h"
+#include "probes.h"
+
+typedef struct LevelSignal {
+    const char* name;
+    int         signum;
+} LevelSignal;
+
+static const LevelSignal level_signals[] = {
+    { "none", 0 },
+    { "SIGHUP", SIGHUP },
+    { "SIGUSR1", SIGUSR1 },
+    { "SIGUSR2", SIGUSR2 },
+    { NULL, 0 }
+};
+
+static int              threshold       = LOG_DEBUG;    /* level in effect */
+static int              base_threshold  = LOG_DEBUG;    /* level set by -threshold */
+static time_t           next_poll       = 0;
+static int              signal_index    = 0;
+static struct sigaction previous_action;
+
+static Tcl_Mutex        level_file_lock;
+static char*            level_file      = NULL;
+static bool             level_file_read = false;   /* level_file_stat is valid */
+static struct stat      level_file_stat;
+
+/*
+ * threshold_fork_prepare, threshold_fork_release
+ *
+ * The control file lock is held across fork, the last of the locks
+ * taken by SyslogForkPrepare: the child never finds it held by a thread
+ * that doesn't exist after fork
+ */
+
+void threshold_fork_prepare (void)
+{
+    Tcl_MutexLock(&level_file_lock);
+}
+
+void threshold_fork_release (void)
+{
+    Tcl_MutexUnlock(&level_file_lock);
+}
+
+static void threshold_signal_handler (int signum)
+{
+    int level = SYSLOG_ATOMIC_LOAD(threshold);
+
+    SYSLOG_ATOMIC_STORE(threshold,(level >= LOG_DEBUG) ? SYSLOG_ATOMIC_LOAD(base_threshold) : level + 1);
+}
+
+/*
+ * threshold_file_changed
+ *
+ * Whether st describes a file different from the one last read
+ */
+
+static bool threshold_file_changed (const struct stat* st)
+{
+    if (!level_file_read) { return true; }
+    if ((st->st_ino != level_file_stat.st_ino) || (st->st_dev != level_file_stat.st_dev) ||
+        (st->st_size != level_file_stat.st_size) || (st->st_mtime != level_file_stat.st_mtime)) {
+        return true;
+    }
+#ifdef HAVE_STRUCT_STAT_ST_MTIM
+    if (st->st_mtim.tv_nsec != level_file_stat.st_mtim.tv_nsec) { return true; }
+#endif
+    return false;
+}
+
+/*
+ * threshold_read_file
+ *
+ * Reads the level name in the control file when it changed since
+ * the last check. Called by at most one thread at a time with
+ * level_file_lock held
+ */
+
+static void threshold_read_file (void)
+{
+    struct stat st;
+    char        buffer[32];
+    FILE*       file;
+    int         level;
+
+    if (stat(level_file,&st) < 0) {
+        if (level_file_read) {
+            level_file_read = false;
+            SYSLOG_ATOMIC_STORE(threshold,SYSLOG_ATOMIC_LOAD(base_threshold));
+        }
+        return;
+    }
+    if (!threshold_file_changed(&st)) { return; }
+    level_file_stat = st;
+    level_file_read = true;
+
+    if ((file = fopen(level_file,"r")) == NULL) { return; }
+    if (fscanf(file,"%31s",buffer) == 1) {
+        char* c;
+
+        for (c = buffer; *c != '\0'; c++) { *c = tolower((unsigned char) *c); }
+        if ((level = level_cli_to_code(NULL,buffer)) != ERROR) {
+            SYSLOG_ATOMIC_STORE(threshold,level);
+        }
+    }
+    fclose(file);
+}
+
+/*
+ * threshold_level
+ *
+ * The level threshold in effect. When a control file is set and a
+ * second has passed since the last check, the thread winning the
+ * compare-and-swap on the poll time checks the file
+ */
+
+int threshold_level (void)
+{
+    if (level_file != NULL) {
+        time_t now  = time(NULL);
+        time_t poll = SYSLOG_ATOMIC_LOAD(next_poll);
+
+        if ((now >= poll) && SYSLOG_ATOMIC_CAS(next_poll,poll,now + 1)) {
+            Tcl_MutexLock(&level_file_lock);
+            if (level_file != NULL) {
+                threshold_read_file();
+            }
+            Tcl_MutexUnlock(&level_file_lock);
+        }
+    }
+    return SYSLOG_ATOMIC_LOAD(threshold);
+}
+
+/*
+ * threshold_enabled
+ *
+ * Whether a message at level passes the threshold
+ */
+
+bool threshold_enabled (int level)
+{
+    int current = threshold_level();
+
+    if (level > current) {
+        SYSLOG_PROBE2(message__filtered,level,current);
+        return false;
+    }
+    return true;
+}
+
+void threshold_set (int level)
+{
+    SYSLOG_ATOMIC_STORE(base_threshold,level);
+    SYSLOG_ATOMIC_STORE(threshold,level);
+}
+
+int threshold_base (void)
+{
+    return SYSLOG_ATOMIC_LOAD(base_threshold);
+}
+
+/*
+ * threshold_set_signal
+ *
+ * Installs the handler of the signal stepping the threshold, restoring
+ * the previous handler of the signal used before. 'none' just restores
+ *
+ * Returned value: TCL_OK or TCL_ERROR (unknown signal name)
+ */
+
+int threshold_set_signal (Tcl_Interp* interp,Tcl_Obj* signal_o)
+{
+    struct sigaction action;
+    int              index;
+
+    if (Tcl_GetIndexFromObjStruct(interp,signal_o,level_signals,sizeof(LevelSignal),
+                                  "signal",0,&index) != TCL_OK) {
+        return TCL_ERROR;
+    }
+    if (index == signal_index) { return TCL_OK; }
+
+    if (signal_index != 0) {
+        sigaction(level_signals[signal_index].signum,&previous_action,NULL);
+    }
+    signal_index = index;
+    if (index != 0) {
+        memset(&action,0,sizeof(action));
+        action.sa_handler = threshold_signal_handler;
+        action.sa_flags   = SA_RESTART;
+        sigemptyset(&action.sa_mask);
+        sigaction(level_signals[index].signum,&action,&previous_action);
+    }
+    return TCL_OK;
+}
+
+const char* threshold_signal (void)
+{
+    return level_signals[signal_index].name;
+}
+
+/*
+ * threshold_set_file
+ *
+ * Sets the control file, an empty path removes it. The file is
+ * read on the next check
+ */
+
+void threshold_set_file (const char* path)
+{
+    Tcl_MutexLock(&level_file_lock);
+    if (level_file != NULL) {
+        Tcl_Free(level_file);
+        level_file = NULL;
+    }
+    if (*path != '\0') {
+        level_file = Tcl_Alloc(strlen(path) + 1);
+        strcpy(level_file,path);
+    }
+    level_file_read = false;
+    SYSLOG_ATOMIC_STORE(next_poll,0);
+    Tcl_MutexUnlock(&level_file_lock);
+}
+
+/*
+ * threshold_file
+ *
+ * Returns in a new object the path of the control file or NULL
+ */
+
+Tcl_Obj* threshold_file (void)
+{
+    Tcl_Obj* path = NULL;
+
+    Tcl_MutexLock(&level_file_lock);
+    if (level_file != NULL) {
+        path = Tcl_NewStringObj(level_file,-1);
+    }
+    Tcl_MutexUnlock(&level_file_lock);
+    return path;
+}
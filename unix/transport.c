@@ -0,0 +1,737 @@
+/*
+ *    transport.c - delivery of log records to the syslog daemon
+ *
+ *    A Tcl interface to the POSIX syslog service.
+ *
+ *    Copyright (C) 2026 Massimo Manghi <mxmanghi@apache.org>
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * The transport replaces the openlog/syslog/closelog calls of the C library.
+ * Records are formatted the way glibc does ('<pri>Mmm dd hh:mm:ss ident[pid]: msg')
+ * and sent with a single sendmsg call to the AF_UNIX socket of the syslog
+ * daemon. Having our own socket lets us target a socket path other than
+ * /dev/log (the test suite runs its own sink) and avoids the copy of the
+ * message that vsyslog does into its internal buffer.
+ *
+ * Connections are sharded: ::syslog::open -connections N opens N independent
+ * sockets and every thread is bound to one of them by a hash of its thread id.
+ * Each shard has its own mutex, so threads bound to different shards never
+ * serialize on a shared descriptor or lock. transport_open is called with
+ * syslogMutex held, transport_close by the thread closing the connection
+ * (see SyslogClose), transport_send only takes the shard lock.
+ * The settings the senders need (ident, socket address, number of shards,
+ * send buffer size and the -pid, -perror and -console flags) are copied by
+ * transport_open in a TransportSettings structure never modified after
+ * it's published through the 'settings' pointer. A sender announces itself
+ * with transport_enter before loading the pointer and leaves when done
+ * with the structure, transport_open waits for every sender that could
+ * still see the previous settings (transport_retire) before freeing them.
+ * The counters the senders increment are spread over cache lines by the
+ * shard hash, the writer flips between two sets of them as userspace RCU
+ * does so that a steady flow of senders can't hold it back. A shard
+ * remembers the generation of the settings it was connected with and is
+ * connected again when it's used with newer settings
+ *
+ * With -nonblocking the records are sent with MSG_DONTWAIT. When the daemon
+ * stops reading and the socket buffer is full the sender waits in poll for
+ * at most -sendtimeout milliseconds, then drops the record instead of
+ * blocking the thread indefinitely. The deadline is set before taking the
+ * shard lock, so the time spent waiting for it shortens the poll. The lock
+ * wait itself can't be cut short (Tcl mutexes have no timed lock): it lasts
+ * as long as the sends of the threads ahead, each within its own deadline. The
+ * dropped records are counted (::syslog::stats) and written to the console
+ * when -console was specified
+ */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE     /* sendmmsg */
+#endif
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <paths.h>
+#include <poll.h>
+#include <syslog.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "syslog.h"
+#include "params.h"
+#include "transport.h"
+
+#ifndef _PATH_CONSOLE
+#define _PATH_CONSOLE   "/dev/console"
+#endif
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL    0
+#endif
+
+extern SyslogGlobalStatus *g_status;
+
+#define SEND_TIMEOUT    -2      /* the record could not be sent within -sendtimeout */
+
+#define READER_STRIDE   16      /* counters of the senders, one per cache line */
+
+typedef struct TransportSettings {
+    unsigned int    generation;
+    int             options;    /* LOG_PID, LOG_PERROR and LOG_CONS */
+    int             sndbuf;
+    int             nshards;
+    char            ident[TRANSPORT_HEADER_SIZE/2];
+    char            socket[sizeof(((struct sockaddr_un *) 0)->sun_path) + 1];
+} TransportSettings;
+
+typedef struct TransportShard {
+    Tcl_Mutex       lock;
+    int             fd;
+    int             type;
+    unsigned int    generation;     /* of the settings the socket was connected with */
+} TransportShard;
+
+static TransportShard       shards[TRANSPORT_MAX_CONNECTIONS];
+static TransportSettings    default_settings = { 0, 0, 0, 1, PACKAGE_NAME, _PATH_LOG };
+static TransportSettings*   settings    = &default_settings;
+static int                  readers[2][TRANSPORT_MAX_CONNECTIONS * READER_STRIDE];
+static int                  reader_epoch = 0;
+static pid_t                log_pid     = 0;
+static Tcl_WideInt          dropped     = 0;
+
+/*
+ * transport_enter
+ *
+ * Returns the settings in effect, which stay valid until transport_leave
+ * is called with the counter stored in reader. The counter is incremented
+ * before the pointer is loaded (sequentially consistent with
+ * transport_retire publishing the pointer and then reading the counters)
+ */
+
+static const TransportSettings* transport_enter (unsigned int hash,int** reader)
+{
+    int epoch = __atomic_load_n(&reader_epoch,__ATOMIC_SEQ_CST);
+
+    *reader = &readers[epoch][(hash % TRANSPORT_MAX_CONNECTIONS) * READER_STRIDE];
+    __atomic_add_fetch(*reader,1,__ATOMIC_SEQ_CST);
+    return __atomic_load_n(&settings,__ATOMIC_SEQ_CST);
+}
+
+static void transport_leave (int* reader)
+{
+    __atomic_sub_fetch(reader,1,__ATOMIC_RELEASE);
+}
+
+/*
+ * transport_retire
+ *
+ * Publishes new settings and frees the previous ones once no sender can
+ * see them. The epoch is flipped twice, each time waiting for the counters
+ * of the epoch left: a sender that read the epoch just before a flip and
+ * incremented its counter after the wait is caught by the second one.
+ * Called with syslogMutex held, a sender never takes it between
+ * transport_enter and transport_leave
+ */
+
+static void transport_retire (TransportSettings* new_settings)
+{
+    TransportSettings*  old = __atomic_exchange_n(&settings,new_settings,__ATOMIC_SEQ_CST);
+    struct timespec     pause = { 0, 100000 };
+    int                 flip;
+    int                 i;
+
+    for (flip = 0; flip < 2; flip++) {
+        int epoch = __atomic_load_n(&reader_epoch,__ATOMIC_SEQ_CST);
+
+        __atomic_store_n(&reader_epoch,1 - epoch,__ATOMIC_SEQ_CST);
+        for (i = 0; i < TRANSPORT_MAX_CONNECTIONS; i++) {
+            while (__atomic_load_n(&readers[epoch][i * READER_STRIDE],__ATOMIC_SEQ_CST) > 0) {
+                nanosleep(&pause,NULL);
+            }
+        }
+    }
+    if (old != &default_settings) {
+        Tcl_Free((char *) old);
+    }
+}
+
+/*
+ * transport_connect
+ *
+ * Connect to the daemon socket. As glibc does we first try a datagram
+ * socket and fall back to a stream socket when the daemon is listening
+ * on one (EPROTOTYPE)
+ */
+
+static int transport_connect (TransportShard* shard,const TransportSettings* s)
+{
+    struct sockaddr_un  addr;
+    const char*         path = s->socket;
+    int                 types[2] = { SOCK_DGRAM, SOCK_STREAM };
+    int                 t;
+
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        errno = ENAMETOOLONG;
+        return ERROR;
+    }
+
+    memset(&addr,0,sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path,path);
+
+    for (t = 0; t < 2; t++) {
+        int fd = socket(AF_UNIX,types[t],0);
+        if (fd < 0) { return ERROR; }
+        fcntl(fd,F_SETFD,FD_CLOEXEC);
+        if (s->sndbuf > 0) {
+            setsockopt(fd,SOL_SOCKET,SO_SNDBUF,&s->sndbuf,sizeof(s->sndbuf));
+        }
+
+        if (connect(fd,(struct sockaddr *) &addr,sizeof(addr)) == 0) {
+            shard->fd         = fd;
+            shard->type       = types[t];
+            shard->generation = s->generation;
+            return TCL_OK;
+        }
+
+        int connect_errno = errno;
+        close(fd);
+        if (connect_errno != EPROTOTYPE) {
+            errno = connect_errno;
+            break;
+        }
+    }
+    return ERROR;
+}
+
+static void transport_disconnect (TransportShard* shard)
+{
+    if (shard->fd >= 0) {
+        close(shard->fd);
+        shard->fd = -1;
+    }
+}
+
+/*
+ * transport_ready
+ *
+ * Connects the shard when it's not connected or was connected with
+ * other settings. Called with the shard lock held
+ */
+
+static int transport_ready (TransportShard* shard,const TransportSettings* s)
+{
+    if ((shard->fd >= 0) && (shard->generation != s->generation)) {
+        transport_disconnect(shard);
+    }
+    return (shard->fd >= 0) ? TCL_OK : transport_connect(shard,s);
+}
+
+/*
+ * transport_shard_hash
+ *
+ * Hash of the calling thread id. Thread ids are usually pointers to
+ * aligned structures: the low bits are dropped and the rest mixed
+ * (Fibonacci hashing) so that consecutive threads spread evenly
+ */
+
+unsigned int transport_shard_hash (void)
+{
+    uintptr_t tid = (uintptr_t) Tcl_GetCurrentThread();
+
+    return (unsigned int) (((uint64_t) (tid >> 4) * 0x9E3779B97F4A7C15ULL) >> 32);
+}
+
+/*
+ * transport_open
+ *
+ * Snapshot of the global status: the ident and pid that go in the header
+ * of every record, the socket path and the options. The new settings
+ * replace the previous ones (see transport_retire). The socket is connected
+ * right away only when -nodelay was specified, otherwise the first message
+ * does it
+ */
+
+int transport_open (void)
+{
+    static unsigned int generation = 0;
+    TransportSettings*  s = (TransportSettings *) Tcl_Alloc(sizeof(TransportSettings));
+    const char*         ident = g_status->ident;
+    const char*         path  = (g_status->socket_path != NULL) ? g_status->socket_path : _PATH_LOG;
+    int                 result = TCL_OK;
+    int                 i;
+
+    if (ident == NULL) {
+        const char* executable = Tcl_GetNameOfExecutable();
+        if (executable != NULL) {
+            const char* tail = strrchr(executable,'/');
+            ident = (tail != NULL) ? tail + 1 : executable;
+        } else {
+            ident = PACKAGE_NAME;
+        }
+    }
+    strncpy(s->ident,ident,sizeof(s->ident) - 1);
+    s->ident[sizeof(s->ident) - 1] = '\0';
+    SYSLOG_ATOMIC_STORE(log_pid,getpid());
+
+    /* a path too long for sockaddr_un is kept so that connect fails */
+
+    strncpy(s->socket,path,sizeof(s->socket) - 1);
+    s->socket[sizeof(s->socket) - 1] = '\0';
+    s->options    = g_status->options & (LOG_PID | LOG_PERROR | LOG_CONS);
+    s->sndbuf     = g_status->sndbuf;
+    s->nshards    = g_status->connections;
+    s->generation = ++generation;
+    transport_retire(s);
+
+    if (g_status->options & LOG_NDELAY) {
+        for (i = 0; i < s->nshards; i++) {
+            Tcl_MutexLock(&shards[i].lock);
+            if (transport_ready(&shards[i],s) != TCL_OK) {
+                result = ERROR;
+            }
+            Tcl_MutexUnlock(&shards[i].lock);
+        }
+    }
+    return result;
+}
+
+/*
+ * transport_close
+ *
+ * Closes every shard, also those beyond the current number of connections
+ * a thread might still be sending to after -connections was reduced
+ */
+
+void transport_close (void)
+{
+    int i;
+
+    for (i = 0; i < TRANSPORT_MAX_CONNECTIONS; i++) {
+        Tcl_MutexLock(&shards[i].lock);
+        transport_disconnect(&shards[i]);
+        Tcl_MutexUnlock(&shards[i].lock);
+    }
+}
+
+/*
+ * transport_fork_prepare, transport_fork_release
+ *
+ * The shard locks are held across fork, taken in index order after the
+ * queue lock and released in reverse order. A thread sending holds its
+ * shard lock, fork waits for the send to complete or time out
+ * (-sendtimeout)
+ */
+
+void transport_fork_prepare (void)
+{
+    int i;
+
+    for (i = 0; i < TRANSPORT_MAX_CONNECTIONS; i++) {
+        Tcl_MutexLock(&shards[i].lock);
+    }
+}
+
+void transport_fork_release (void)
+{
+    int i;
+
+    for (i = TRANSPORT_MAX_CONNECTIONS - 1; i >= 0; i--) {
+        Tcl_MutexUnlock(&shards[i].lock);
+    }
+}
+
+/*
+ * transport_fork_child
+ *
+ * Called in a child process right after fork, with the shard locks
+ * still held. The sockets inherited are the parent's: the child closes
+ * its copy of the descriptors and the first record it sends connects
+ * again
+ */
+
+void transport_fork_child (void)
+{
+    int i;
+
+    for (i = 0; i < TRANSPORT_MAX_CONNECTIONS; i++) {
+        transport_disconnect(&shards[i]);
+    }
+
+    /* the senders counted by the parent don't exist in the child */
+
+    memset(readers,0,sizeof(readers));
+    log_pid = getpid();
+}
+
+void transport_init (void)
+{
+    int i;
+
+    for (i = 0; i < TRANSPORT_MAX_CONNECTIONS; i++) {
+        shards[i].fd   = -1;
+        shards[i].type = SOCK_DGRAM;
+    }
+}
+
+/*
+ * transport_header
+ *
+ * Writes the record header in buffer and returns its length. tag_offset
+ * is set to the start of the 'ident[pid]: ' part which is what we also
+ * write on stderr (-perror) and on the console (-console)
+ */
+
+size_t transport_header (SyslogThreadStatus* status,int pri,char* buffer,size_t size,size_t* tag_offset)
+{
+    const TransportSettings*    s;
+    int*                        reader;
+    time_t                      now = time(NULL);
+    int                         n;
+
+    if (now != status->timestamp_sec) {
+        struct tm tm;
+
+        localtime_r(&now,&tm);
+        strftime(status->timestamp,sizeof(status->timestamp),"%h %e %T",&tm);
+        status->timestamp_sec = now;
+    }
+
+    n = snprintf(buffer,size,"<%d>%s ",pri,status->timestamp);
+    *tag_offset = n;
+    s = transport_enter(status->shard_hash,&reader);
+    if (s->options & LOG_PID) {
+        n += snprintf(buffer+n,size-n,"%s[%d]: ",s->ident,(int) SYSLOG_ATOMIC_LOAD(log_pid));
+    } else {
+        n += snprintf(buffer+n,size-n,"%s: ",s->ident);
+    }
+    transport_leave(reader);
+    return (n < (int) size) ? (size_t) n : size - 1;
+}
+
+static long transport_now_ms (void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC,&ts);
+    return (long) ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/*
+ * transport_write
+ *
+ * Writes the niov segments in iov to the shard socket. A stream socket may
+ * accept only part of the record, the rest is written by further calls.
+ * When deadline is >= 0 the socket is never waited on past it (the
+ * CLOCK_MONOTONIC time in milliseconds)
+ *
+ * Returned value: TCL_OK, ERROR or SEND_TIMEOUT
+ */
+
+static int transport_write (TransportShard* shard,struct iovec* iov,int niov,long deadline)
+{
+    struct iovec    pending[TRANSPORT_MAX_BODY_IOV + 3];
+    struct msghdr   msg;
+    int             flags = MSG_NOSIGNAL;
+
+    if (deadline >= 0) { flags |= MSG_DONTWAIT; }
+
+    memcpy(pending,iov,niov*sizeof(struct iovec));
+    memset(&msg,0,sizeof(msg));
+    msg.msg_iov    = pending;
+    msg.msg_iovlen = niov;
+
+    while (msg.msg_iovlen > 0) {
+        ssize_t sent = sendmsg(shard->fd,&msg,flags);
+
+        if (sent < 0) {
+            struct pollfd   pfd;
+            long            wait;
+
+            if (errno == EINTR) { continue; }
+            if ((deadline < 0) || ((errno != EAGAIN) && (errno != EWOULDBLOCK))) {
+                return ERROR;
+            }
+            if ((wait = deadline - transport_now_ms()) <= 0) {
+                return SEND_TIMEOUT;
+            }
+            pfd.fd      = shard->fd;
+            pfd.events  = POLLOUT;
+            pfd.revents = 0;
+            if ((poll(&pfd,1,(int) wait) < 0) && (errno != EINTR)) {
+                return ERROR;
+            }
+            continue;
+        }
+
+        /* datagrams are sent whole, a stream may need more calls */
+
+        if (shard->type != SOCK_STREAM) { break; }
+        while ((msg.msg_iovlen > 0) && ((size_t) sent >= msg.msg_iov->iov_len)) {
+            sent -= msg.msg_iov->iov_len;
+            msg.msg_iov++;
+            msg.msg_iovlen--;
+        }
+        if (msg.msg_iovlen > 0) {
+            msg.msg_iov->iov_base = (char *) msg.msg_iov->iov_base + sent;
+            msg.msg_iov->iov_len -= sent;
+        }
+    }
+    return TCL_OK;
+}
+
+/*
+ * transport_perror
+ *
+ * Writes a record from its tag on to stderr when -perror was specified.
+ * Called by the ring and the queue when the record is stored: it's sent
+ * later by another thread or process
+ */
+
+void transport_perror (const char* header,size_t header_len,size_t tag_offset,const struct iovec* body,int nbody)
+{
+    struct iovec    iov[TRANSPORT_MAX_BODY_IOV + 2];
+    int*            reader;
+    bool            perror = ((transport_enter(transport_shard_hash(),&reader)->options & LOG_PERROR) != 0);
+
+    transport_leave(reader);
+    if (!perror) { return; }
+
+    if (nbody > TRANSPORT_MAX_BODY_IOV) { nbody = TRANSPORT_MAX_BODY_IOV; }
+    iov[0].iov_base = (char *) header + tag_offset;
+    iov[0].iov_len  = header_len - tag_offset;
+    memcpy(&iov[1],body,nbody*sizeof(struct iovec));
+    iov[nbody+1].iov_base = "\n";
+    iov[nbody+1].iov_len  = 1;
+    if (writev(STDERR_FILENO,iov,nbody+2) < 0) { /* ignored */ }
+}
+
+Tcl_WideInt transport_dropped (void)
+{
+    return SYSLOG_ATOMIC_LOAD(dropped);
+}
+
+static void transport_console (struct iovec* iov,int niov)
+{
+    int fd = open(_PATH_CONSOLE,O_WRONLY|O_NOCTTY);
+    if (fd >= 0) {
+        iov[niov].iov_base = "\r\n";
+        iov[niov].iov_len  = 2;
+        if (writev(fd,iov,niov+1) < 0) { /* nothing left we can do */ }
+        close(fd);
+    }
+}
+
+/*
+ * transport_send_records
+ *
+ * Sends count records (at most TRANSPORT_MAX_BATCH) already formatted,
+ * header included, holding the shard lock once. On datagram sockets the batch goes with a single
+ * sendmmsg call where available. Records that can't be sent are
+ * counted as dropped (and written to the console with -console)
+ *
+ * Returned value: number of records sent
+ */
+
+int transport_send_records (SyslogThreadStatus* status,struct iovec* records,int count)
+{
+    int*                        reader;
+    const TransportSettings*    s = transport_enter(status->shard_hash,&reader);
+    TransportShard*             shard = &shards[status->shard_hash % s->nshards];
+    long                        deadline = -1;
+    int                         sent = 0;
+    int                         attempt;
+
+    if (SYSLOG_ATOMIC_LOAD(g_status->options) & SYSLOG_NONBLOCKING) {
+        deadline = transport_now_ms() + SYSLOG_ATOMIC_LOAD(g_status->send_timeout);
+    }
+
+    SYSLOG_PROBE1(send__lock,(int) (shard - shards));
+    Tcl_MutexLock(&shard->lock);
+    SYSLOG_PROBE2(send__batch,(int) (shard - shards),count);
+    for (attempt = 0; (attempt < 2) && (sent < count); attempt++) {
+        int result = TCL_OK;
+
+        if (transport_ready(shard,s) != TCL_OK) { break; }
+
+#ifdef HAVE_SENDMMSG
+        if (shard->type == SOCK_DGRAM) {
+            struct mmsghdr  msgs[TRANSPORT_MAX_BATCH];
+            int             i;
+
+            memset(msgs,0,count*sizeof(struct mmsghdr));
+            for (i = 0; i < count; i++) {
+                msgs[i].msg_hdr.msg_iov    = &records[i];
+                msgs[i].msg_hdr.msg_iovlen = 1;
+            }
+            while ((sent < count) && (result == TCL_OK)) {
+                int n = sendmmsg(shard->fd,msgs + sent,count - sent,
+                                 MSG_NOSIGNAL | ((deadline >= 0) ? MSG_DONTWAIT : 0));
+                if (n > 0) {
+                    sent += n;
+                } else if ((n < 0) && (errno == EINTR)) {
+                    continue;
+                } else {
+
+                    /* let transport_write wait for the socket or report the error */
+
+                    result = transport_write(shard,&records[sent],1,deadline);
+                    if (result == TCL_OK) { sent++; }
+                }
+            }
+        } else
+#endif
+        {
+            struct iovec record[2];
+
+            while ((sent < count) && (result == TCL_OK)) {
+                record[0] = records[sent];
+                record[1].iov_base = "";
+                record[1].iov_len  = 1;
+                result = transport_write(shard,record,(shard->type == SOCK_STREAM) ? 2 : 1,deadline);
+                if (result == TCL_OK) { sent++; }
+            }
+        }
+
+        if (result == TCL_OK) { break; }
+        if ((result == ERROR) || (shard->type == SOCK_STREAM)) {
+            transport_disconnect(shard);
+        }
+        if (result == SEND_TIMEOUT) { break; }
+    }
+    Tcl_MutexUnlock(&shard->lock);
+    SYSLOG_PROBE2(send__batch__done,(int) (shard - shards),sent);
+
+    if (sent < count) {
+        int i;
+
+        SYSLOG_ATOMIC_ADD(dropped,count - sent);
+        if (s->options & LOG_CONS) {
+
+            /* the console gets the record from the timestamp on */
+
+            for (i = sent; i < count; i++) {
+                struct iovec    iov[2];
+                char*           text = memchr(records[i].iov_base,'>',records[i].iov_len);
+
+                text = (text != NULL) ? text + 1 : records[i].iov_base;
+                iov[0].iov_base = text;
+                iov[0].iov_len  = records[i].iov_len - (text - (char *) records[i].iov_base);
+                transport_console(iov,1);
+            }
+        }
+    }
+    transport_leave(reader);
+    return sent;
+}
+
+/*
+ * transport_send
+ *
+ * Sends a record made of the header and the nbody segments in body.
+ * On failure the connection is reestablished and the send attempted
+ * once more before giving up (and writing to the console when
+ * -console was specified). A record that could not be sent within
+ * -sendtimeout is not attempted again: the daemon is not reading
+ *
+ * Returned value: TCL_OK or ERROR
+ */
+
+int transport_send (SyslogThreadStatus* status,int pri,struct iovec* body,int nbody)
+{
+    int*                        reader;
+    const TransportSettings*    s = transport_enter(status->shard_hash,&reader);
+    TransportShard*             shard = &shards[status->shard_hash % s->nshards];
+    char                        header[TRANSPORT_HEADER_SIZE];
+    struct iovec                iov[TRANSPORT_MAX_BODY_IOV + 3];
+    size_t                      tag_offset;
+    int                         niov;
+    int                         attempt;
+    int                         result = ERROR;
+    long                        deadline = -1;
+#ifdef HAVE_USDT_PROBES
+    size_t                      body_length = 0;
+    int                         i;
+#endif
+
+    if (nbody > TRANSPORT_MAX_BODY_IOV) { nbody = TRANSPORT_MAX_BODY_IOV; }
+
+    iov[0].iov_base = header;
+    iov[0].iov_len  = transport_header(status,pri,header,sizeof(header),&tag_offset);
+    memcpy(&iov[1],body,nbody*sizeof(struct iovec));
+    niov = nbody + 1;
+#ifdef HAVE_USDT_PROBES
+    for (i = 0; i < nbody; i++) {
+        body_length += body[i].iov_len;
+    }
+#endif
+
+    if (SYSLOG_ATOMIC_LOAD(g_status->options) & SYSLOG_NONBLOCKING) {
+        deadline = transport_now_ms() + SYSLOG_ATOMIC_LOAD(g_status->send_timeout);
+    }
+
+    SYSLOG_PROBE1(send__lock,(int) (shard - shards));
+    Tcl_MutexLock(&shard->lock);
+    SYSLOG_PROBE2(send__start,(int) (shard - shards),(int) (iov[0].iov_len + body_length));
+    for (attempt = 0; attempt < 2; attempt++) {
+        if (transport_ready(shard,s) != TCL_OK) { break; }
+
+        /* stream sockets need the record terminator */
+
+        iov[niov].iov_base = "";
+        iov[niov].iov_len  = 1;
+
+        result = transport_write(shard,iov,(shard->type == SOCK_STREAM) ? niov + 1 : niov,deadline);
+        if (result == TCL_OK) { break; }
+
+        /* a stream interrupted in the middle of a record can't be resumed */
+
+        if ((result == ERROR) || (shard->type == SOCK_STREAM)) {
+            transport_disconnect(shard);
+        }
+        if (result == SEND_TIMEOUT) { break; }
+    }
+    Tcl_MutexUnlock(&shard->lock);
+    SYSLOG_PROBE2(send__done,(int) (shard - shards),result);
+
+    if (result != TCL_OK) {
+        SYSLOG_ATOMIC_INCR(dropped);
+        result = ERROR;
+    }
+
+    iov[0].iov_base = header + tag_offset;
+    iov[0].iov_len -= tag_offset;
+
+    if ((result != TCL_OK) && (s->options & LOG_CONS)) {
+        transport_console(iov,niov);
+    }
+
+    if (s->options & LOG_PERROR) {
+        iov[niov].iov_base = "\n";
+        iov[niov].iov_len  = 1;
+        if (writev(STDERR_FILENO,iov,niov+1) < 0) { /* ignored */ }
+    }
+    transport_leave(reader);
+    return result;
+}
@@ -0,0 +1,65 @@
+/*
+ *    transport.h - delivery of log records to the syslog daemon
+ *
+ *    A Tcl interface to the POSIX syslog service.
+ *
+ *    Copyright (C) 2026 Massimo Manghi <mxmanghi@apache.org>
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __transport_h__
+#define __transport_h__
+
+#include <sys/uio.h>
+#include "syslog.h"
+
+#ifndef _PATH_LOG
+#define _PATH_LOG           "/dev/log"
+#endif
+
+/* room for '<pri>Mmm dd hh:mm:ss ident[pid]: ' */
+
+#define TRANSPORT_HEADER_SIZE   512
+
+/* upper bound of the iovec segments a record body can be made of */
+
+#define TRANSPORT_MAX_BODY_IOV  8
+
+/* upper bound of -connections */
+
+#define TRANSPORT_MAX_CONNECTIONS   64
+
+/* upper bound of the records sent by transport_send_records */
+
+#define TRANSPORT_MAX_BATCH     64
+
+/* upper bound of -sendtimeout (milliseconds) */
+
+#define TRANSPORT_MAX_SEND_TIMEOUT  60000
+
+void        transport_init (void);
+unsigned int transport_shard_hash (void);
+int         transport_open (void);
+void        transport_close (void);
+void        transport_fork_prepare (void);
+void        transport_fork_release (void);
+void        transport_fork_child (void);
+size_t      transport_header (SyslogThreadStatus* status,int pri,char* buffer,size_t size,size_t* tag_offset);
+int         transport_send (SyslogThreadStatus* status,int pri,struct iovec* body,int nbody);
+int         transport_send_records (SyslogThreadStatus* status,struct iovec* records,int count);
+void        transport_perror (const char* header,size_t header_len,size_t tag_offset,const struct iovec* body,int nbody);
+Tcl_WideInt transport_dropped (void);
+
+#endif /* __transport_h__ */